@@ -16,7 +16,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 #include "Cyclist.h"
 
-static void ref_assert(bool condition, const std::string &synopsis, const char *fct)
+static void ref_assert(bool condition, const char *synopsis, const char *fct)
 {
 	if (!condition)
 	{
@@ -41,20 +41,63 @@ Cyclist::Cyclist(BaseIterableTransformation &f,
                  const BitString &K,
                  const BitString &id,
                  const BitString &counter)
-	: f(f), Rkin(Rkin), Rkout(Rkout), lratchet(lratchet)
+	: f(f), Rhash(Rhash), Rkin(Rkin), Rkout(Rkout), lratchet(lratchet)
 {
 	assert((f.width % 8) == 0,
 		"This implementation only supports permutation width that are multiple of 8."); // Limitation of Transformation class
 
 	fbp = f.width / 8;
 	phase = PHASE_UP;
-	s = BitString::zeroes(8 * fbp);
+	s = ByteBuffer(fbp, 0);
 	mode = MODE_HASH;
 	Rabsorb = Rhash;
 	Rsqueeze = Rhash;
+	crypting = false;
+	cryptOffset = 0;
 	if (K.size() != 0) AbsorbKey(K, id, counter);
 }
 
+Cyclist::Cyclist(BaseIterableTransformation &f,
+                 unsigned int Rhash,
+                 unsigned int Rkin,
+                 unsigned int Rkout,
+                 unsigned int lratchet,
+                 const CyclistSnapshot &S)
+	: Cyclist(f, Rhash, Rkin, Rkout, lratchet, BitString(), BitString(), BitString())
+{
+	restore(S);
+}
+
+CyclistSnapshot Cyclist::snapshot() const
+{
+	CyclistSnapshot S;
+
+	S.s = BitString(s.data(), 8 * fbp);
+	S.phase = phase;
+	S.mode = mode;
+	S.Rabsorb = Rabsorb;
+	S.Rsqueeze = Rsqueeze;
+	S.crypting = crypting;
+	S.cryptOffset = cryptOffset;
+	return S;
+}
+
+void Cyclist::restore(const CyclistSnapshot &S)
+{
+	assert(S.s.size() == 8 * fbp, "The snapshot must hold a state of the permutation width");
+	assert((S.mode == MODE_HASH) ? (S.Rabsorb == Rhash && S.Rsqueeze == Rhash) : (S.Rabsorb == Rkin && S.Rsqueeze == Rkout),
+		"The snapshot rates must be those of its mode");
+	assert(!S.crypting || (S.mode == MODE_KEYED && S.cryptOffset <= Rkout), "The snapshot chunked Crypt() position is invalid");
+
+	s.assign(S.s.array(), S.s.array() + fbp);
+	phase = S.phase;
+	mode = S.mode;
+	Rabsorb = S.Rabsorb;
+	Rsqueeze = S.Rsqueeze;
+	crypting = S.crypting;
+	cryptOffset = S.crypting ? S.cryptOffset : 0;
+}
+
 void Cyclist::Absorb(const BitString &X)
 {
 	AbsorbAny(X, Rabsorb, CONSTANT_ABSORB);
@@ -74,12 +117,40 @@ BitString Cyclist::Decrypt(const BitString &C)
 	return Crypt(C, true);
 }
 
-BitString Cyclist::Squeeze(unsigned int l)
+/*
+ * The chunked interface processes the bytes of a single Encrypt() or Decrypt() as they
+ * come. Consecutive calls continue the same message: a partial block is carried over to
+ * the next call. The message ends with Finalize(), or with any call other than an update;
+ * Finalize() without any update before it ends an empty message.
+ */
+void Cyclist::EncryptUpdate(const UINT8 *in, UINT8 *out, size_t len)
+{
+	assert(mode == MODE_KEYED, "Mode must be 'keyed'");
+
+	CryptUpdate(in, out, len, false);
+}
+
+void Cyclist::DecryptUpdate(const UINT8 *in, UINT8 *out, size_t len)
+{
+	assert(mode == MODE_KEYED, "Mode must be 'keyed'");
+
+	CryptUpdate(in, out, len, true);
+}
+
+BitString Cyclist::Finalize(UINT64 l)
+{
+	assert(mode == MODE_KEYED, "Mode must be 'keyed'");
+
+	if (!crypting) CryptUpdate(NULL, NULL, 0, false);                // An empty message
+	return Squeeze(l);
+}
+
+BitString Cyclist::Squeeze(UINT64 l)
 {
 	return SqueezeAny(l, CONSTANT_SQUEEZE);
 }
 
-BitString Cyclist::SqueezeKey(unsigned int l)
+BitString Cyclist::SqueezeKey(UINT64 l)
 {
 	assert(mode == MODE_KEYED, "Mode must be 'keyed'");
 
@@ -95,9 +166,11 @@ void Cyclist::Ratchet()
 
 void Cyclist::AbsorbAny(const BitString &X, unsigned int r, UINT8 cD)
 {
+	EndCrypt();
+
 	Blocks Xb = Split(X, r);
 
-	for (unsigned int i = 0; i < Xb.size(); i++)
+	for (UINT64 i = 0; i < Xb.size(); i++)
 	{
 		if (phase != PHASE_UP) Up(0, CONSTANT_ZERO);
 		Down(Xb[i], (i == 0) ? cD : CONSTANT_ZERO);
@@ -121,46 +194,171 @@ void Cyclist::AbsorbKey(const BitString &K, const BitString &id, const BitString
 
 BitString Cyclist::Crypt(const BitString &I, bool decrypt)
 {
-	Blocks Ib = Split(I, Rkout);
-	Blocks Ob(8 * Rkout);
+	assert((I.size() % 8) == 0, "|I| must be a whole number of bytes");
 
-	for (unsigned int i = 0; i < Ib.size(); i++)
+	BitString O = BitString::zeroes(I.size());
+
+	EndCrypt();
+	CryptUpdate(I.array(), O.array(), (size_t)(I.size() / 8), decrypt);
+	EndCrypt();
+
+	return O;
+}
+
+/*
+ * Up() and Down() of the Crypt() blocks, a byte at a time: after Up(), the state holds the
+ * key stream, and xoring the plaintext into it leaves the ciphertext. A full block is only
+ * padded and permuted once a byte of the next one comes, as the message may end there.
+ */
+void Cyclist::CryptUpdate(const UINT8 *in, UINT8 *out, size_t len, bool decrypt)
+{
+	if (!crypting)
+	{
+		Up(0, CONSTANT_CRYPT);
+		crypting = true;
+		cryptOffset = 0;
+	}
+
+	while (len > 0)
 	{
-		Ob[i] = Ib[i] ^ Up(Ib[i].size() / 8, (i == 0) ? CONSTANT_CRYPT : CONSTANT_ZERO);
-		Block Pi = decrypt ? Ob[i] : Ib[i];
-		Down(Pi, CONSTANT_ZERO);
+		if (cryptOffset == Rkout)
+		{
+			s[cryptOffset] ^= 0x01;
+			Up(0, CONSTANT_ZERO);
+			cryptOffset = 0;
+		}
+
+		size_t n = std::min<size_t>(len, Rkout - cryptOffset);
+		UINT8 *k = s.data() + cryptOffset;
+
+		for (size_t i = 0; i < n; i++)
+		{
+			UINT8 x = in[i];
+			UINT8 y = x ^ k[i];
+			out[i] = y;
+			k[i] = decrypt ? x : y;
+		}
+
+		in += n;
+		out += n;
+		len -= n;
+		cryptOffset += (unsigned int)n;
 	}
+}
+
+/* Down() of the last Crypt() block, the ciphertext being already in the state */
+void Cyclist::EndCrypt()
+{
+	if (!crypting) return;
 
-	return Ob.bits();
+	s[cryptOffset] ^= 0x01;
+	phase = PHASE_DOWN;
+	crypting = false;
 }
 
-BitString Cyclist::SqueezeAny(unsigned int l, UINT8 cU)
+BitString Cyclist::SqueezeAny(UINT64 l, UINT8 cU)
 {
-	BitString Y = Up(std::min(l, Rsqueeze), cU);
+	assert(l <= ~(UINT64)0 / 8, "l must be less than 2^61 bytes");
+	EndCrypt();
+
+	BitString Y = BitString::zeroes(8 * l);
+	UINT64 done = std::min<UINT64>(l, Rsqueeze);
 
-	while (Y.size() / 8 < l)
+	Y.overwrite(Up((unsigned int)done, cU), 0);
+	while (done < l)
 	{
-		Down(BitString(), CONSTANT_ZERO);
-		Y = Y || Up(std::min(l - Y.size() / 8, Rsqueeze), CONSTANT_ZERO);
+		UINT64 Yi = std::min<UINT64>(l - done, Rsqueeze);
+
+		Down(BitStringView(), CONSTANT_ZERO);
+		Y.overwrite(Up((unsigned int)Yi, CONSTANT_ZERO), 8 * done);
+		done += Yi;
 	}
 
 	return Y;
 }
 
-void Cyclist::Down(const BitString &Xi, UINT8 cD)
+/* s ^= Xi || 0x01 || 0^* || cD, on the state bytes */
+void Cyclist::Down(const BitStringView &Xi, UINT8 cD)
 {
+	assert(Xi.size() <= 8 * (fbp - 2), "Xi must fit in the state with its padding and color");
+
+	BitString copy;
+	const UINT8 *x = Xi.data();
+	size_t full = (size_t)(Xi.size() / 8);
+	unsigned int rest = (unsigned int)(Xi.size() % 8);
+
+	if (Xi.bitOffset() != 0)                                         // Xi does not start on a byte
+	{
+		copy = BitString(Xi);
+		x = copy.array();
+	}
+
 	phase = PHASE_DOWN;
-	s = s ^ (Xi || BitString(8, 0x01) || BitString::zeroes(8 * (fbp - 2) - Xi.size()) || BitString(8, (mode == MODE_HASH) ? (cD & 0x01) : cD));
+	for (size_t i = 0; i < full; i++) s[i] ^= x[i];
+	if (rest) s[full] ^= x[full] & ((1 << rest) - 1);
+	s[full] ^= (UINT8)(0x01 << rest);
+	s[fbp - 1] ^= (mode == MODE_HASH) ? (cD & 0x01) : cD;
 }
 
-BitString Cyclist::Up(unsigned int Yi, UINT8 cU)
+BitStringView Cyclist::Up(unsigned int Yi, UINT8 cU)
 {
 	phase = PHASE_UP;
-	s = f((mode == MODE_HASH) ? s : (s ^ (BitString::zeroes(8 * (fbp - 1)) || BitString(8, cU))));
-	return BitString::substring(s, 0, 8 * Yi);
+	if (mode != MODE_HASH) s[fbp - 1] ^= cU;
+	f.apply(s.data());
+	return BitStringView(s.data(), 0, 8 * Yi);
 }
 
 Blocks Cyclist::Split(const BitString &X, unsigned int n)
 {
 	return Blocks(X, 8 * n);
 }
+
+/*
+ * CyclistSnapshot
+ *
+ * Serialized as a version byte (1), then one byte each for the mode, the phase, crypting,
+ * cryptOffset, Rabsorb, Rsqueeze and the state length in bytes, and then the state.
+ */
+static const UINT8 SnapshotVersion = 1;
+static const unsigned int SnapshotHeader = 8;
+
+BitString CyclistSnapshot::serialize() const
+{
+	assert((s.size() % 8) == 0 && s.size() / 8 <= 255 && Rabsorb <= 255 && Rsqueeze <= 255 && cryptOffset <= 255,
+		"The snapshot sizes must fit in one byte each");
+
+	std::vector<UINT8> data(SnapshotHeader);
+
+	data[0] = SnapshotVersion;
+	data[1] = (UINT8)mode;
+	data[2] = (UINT8)phase;
+	data[3] = crypting ? 1 : 0;
+	data[4] = (UINT8)cryptOffset;
+	data[5] = (UINT8)Rabsorb;
+	data[6] = (UINT8)Rsqueeze;
+	data[7] = (UINT8)(s.size() / 8);
+	data.insert(data.end(), s.array(), s.array() + s.size() / 8);
+
+	return BitString(data);
+}
+
+CyclistSnapshot CyclistSnapshot::deserialize(const BitString &data)
+{
+	const UINT8 *d = data.array();
+
+	assert(data.size() >= 8 * SnapshotHeader && d[0] == SnapshotVersion, "Unknown snapshot format");
+	assert(data.size() == 8 * (SnapshotHeader + d[7]), "The snapshot length does not match its state");
+	assert(d[1] <= MODE_KEYED && d[2] <= PHASE_DOWN && d[3] <= 1, "Invalid snapshot mode, phase or flag");
+
+	CyclistSnapshot S;
+
+	S.mode = (CyclistMode)d[1];
+	S.phase = (CyclistPhase)d[2];
+	S.crypting = (d[3] != 0);
+	S.cryptOffset = d[4];
+	S.Rabsorb = d[5];
+	S.Rsqueeze = d[6];
+	S.s = BitString(d + SnapshotHeader, 8 * d[7]);
+
+	return S;
+}
@@ -42,6 +42,27 @@ enum CyclistMode
 	MODE_KEYED,
 };
 
+/**
+ * Class holding the state of a Cyclist instance
+ *
+ * It is all that evolves in Cyclist, so restoring it resumes the instance
+ * where it was taken, including a chunked Encrypt()/Decrypt() in progress.
+ * serialize() gives a compact byte string from which deserialize() rebuilds it.
+ */
+class CyclistSnapshot
+{
+	public:
+		BitString      s;
+		CyclistPhase   phase;
+		CyclistMode    mode;
+		unsigned int   Rabsorb, Rsqueeze;
+		bool           crypting;
+		unsigned int   cryptOffset;
+
+		BitString               serialize() const;
+		static CyclistSnapshot  deserialize(const BitString &data);
+};
+
 /**
  * Class implementing the Cyclist construction
  */
@@ -49,28 +70,39 @@ class Cyclist
 {
 	protected:
 		BaseIterableTransformation &f;
-		unsigned int               fbp, Rkin, Rkout, lratchet;
+		unsigned int               fbp, Rhash, Rkin, Rkout, lratchet;
 		CyclistPhase               phase;
-		BitString                  s;
+		ByteBuffer                 s;                                // fbp bytes, updated in place
 		CyclistMode                mode;
 		unsigned int               Rabsorb, Rsqueeze;
+		bool                       crypting;                         // An EncryptUpdate() or DecryptUpdate() block is open
+		unsigned int               cryptOffset;                      // Bytes of that block already processed
 
 		void AbsorbAny(const BitString &X, unsigned int r, UINT8 cD);
 		void AbsorbKey(const BitString &K, const BitString &id, const BitString &counter);
 		BitString Crypt(const BitString &I, bool decrypt);
-		BitString SqueezeAny(unsigned int l, UINT8 cU);
-		void Down(const BitString &Xi, UINT8 cD);
-		BitString Up(unsigned int Yi, UINT8 cU);
+		void CryptUpdate(const UINT8 *in, UINT8 *out, size_t len, bool decrypt);
+		void EndCrypt();
+		BitString SqueezeAny(UINT64 l, UINT8 cU);
+		void Down(const BitStringView &Xi, UINT8 cD);
+		BitStringView Up(unsigned int Yi, UINT8 cU);                 // Valid until the next Down() or Up()
 		Blocks Split(const BitString &X, unsigned int n);
 
 	public:
 		Cyclist(BaseIterableTransformation &f, unsigned int Rhash, unsigned int Rkin, unsigned int Rkout, unsigned int lratchet,
 			    const BitString &K, const BitString &id, const BitString &counter);
+		Cyclist(BaseIterableTransformation &f, unsigned int Rhash, unsigned int Rkin, unsigned int Rkout, unsigned int lratchet,
+			    const CyclistSnapshot &S);
+		CyclistSnapshot snapshot() const;
+		void restore(const CyclistSnapshot &S);                        // Throws if S does not fit this instance's parameters
 		void Absorb(const BitString &X);
 		BitString Encrypt(const BitString &P);
 		BitString Decrypt(const BitString &C);
-		BitString Squeeze(unsigned int l);
-		BitString SqueezeKey(unsigned int l);
+		void EncryptUpdate(const UINT8 *in, UINT8 *out, size_t len);   // Encrypt() in chunks of any size, in may be out
+		void DecryptUpdate(const UINT8 *in, UINT8 *out, size_t len);
+		BitString Finalize(UINT64 l);                                  // Ends the chunked Encrypt()/Decrypt() and squeezes l bytes
+		BitString Squeeze(UINT64 l);
+		BitString SqueezeKey(UINT64 l);
 		void Ratchet();
 };
 
@@ -11,12 +11,16 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Farfalle.h"
+#include "threadpool.h"
 
-static void ref_assert(bool condition, const std::string &synopsis, const char *fct)
+static void ref_assert(bool condition, const char *synopsis, const char *fct)
 {
 	if (!condition)
 	{
@@ -32,13 +36,127 @@ static void ref_assert(bool condition, const std::string &synopsis, const char *
 #define assert(cond, msg)  ref_assert(cond, msg, __FUNCTION__)
 #endif
 
+/* Number of independent permutation calls handed at once to BaseIterableTransformation::applyAll() */
+static const unsigned int BatchSize = 16;
+
+/* Number of input or output blocks per task of a parallel compression or expansion */
+static const UINT64 ChunkBlocks = 1024;
+
+/* BaseRollingFunction */
+void BaseRollingFunction::step(BitString &k) const
+{
+	k = (*this)(k, 1);
+}
+
 /* IdentityRollingFunction */
-BitString IdentityRollingFunction::operator()(const BitString &k, unsigned int i) const
+BitString IdentityRollingFunction::operator()(const BitString &k, UINT64 i) const
 {
     (void)i;
 	return k;
 }
 
+void IdentityRollingFunction::step(BitString &k) const
+{
+	(void)k;
+}
+
+/* LinearRollingFunction */
+LinearRollingFunction::LinearRollingFunction(unsigned int width)
+	: width(width), words((width + 63) / 64), levels(0)
+{
+}
+
+/* Returns M^(2^j), computing it and the lower powers first if needed */
+const std::vector<UINT64> &LinearRollingFunction::power(unsigned int j) const
+{
+	if (j < levels.load(std::memory_order_acquire)) return powers[j];
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	for (unsigned int level = levels.load(std::memory_order_relaxed); level <= j; level++)
+	{
+		std::vector<UINT64> &M = powers[level];
+		M.assign((size_t)width * words, 0);
+
+		for (unsigned int r = 0; r < width; r++)
+		{
+			if (level == 0)                                          // The image of bit r by the step
+			{
+				BitString e = BitString::zeroes(width);
+				e.array()[r / 8] = (UINT8)(1 << (r % 8));
+				step(e);
+				for (unsigned int i = 0; i < width; i++)
+				{
+					if ((e.array()[i / 8] >> (i % 8)) & 1) M[words * r + i / 64] |= (UINT64)1 << (i % 64);
+				}
+			}
+			else                                                     // M^(2^level) = (M^(2^(level-1)))^2
+			{
+				apply(powers[level - 1], &powers[level - 1][words * r], &M[words * r]);
+			}
+		}
+
+		levels.store(level + 1, std::memory_order_release);
+	}
+
+	return powers[j];
+}
+
+/* out = M v */
+void LinearRollingFunction::apply(const std::vector<UINT64> &M, const UINT64 *v, UINT64 *out) const
+{
+	std::fill(out, out + words, 0);
+
+	for (unsigned int r = 0; r < width; r++)
+	{
+		if ((v[r / 64] >> (r % 64)) & 1)
+		{
+			for (unsigned int w = 0; w < words; w++)
+			{
+				out[w] ^= M[words * r + w];
+			}
+		}
+	}
+}
+
+BitString LinearRollingFunction::operator()(const BitString &k, UINT64 i) const
+{
+	BitString kp = k;
+
+	if (i < JumpThreshold)
+	{
+		for (UINT64 j = 0; j < i; j++) step(kp);
+		return kp;
+	}
+
+	std::vector<UINT64> v(words, 0), w(words);
+
+	for (unsigned int r = 0; r < width; r++)
+	{
+		if ((kp.array()[r / 8] >> (r % 8)) & 1) v[r / 64] |= (UINT64)1 << (r % 64);
+	}
+	for (unsigned int j = 0; j < 64 && (i >> j) != 0; j++)
+	{
+		if ((i >> j) & 1)
+		{
+			apply(power(j), v.data(), w.data());
+			v.swap(w);
+		}
+	}
+	for (unsigned int r = 0; r < width; r++)
+	{
+		kp.array()[r / 8] = (UINT8)((kp.array()[r / 8] & ~(1 << (r % 8))) | (((v[r / 64] >> (r % 64)) & 1) << (r % 8)));
+	}
+
+	return kp;
+}
+
+/* RollingIterator */
+RollingIterator::RollingIterator(const BaseRollingFunction &roll, const BitString &k, UINT64 i)
+	: roll(roll), k((i == 0) ? k : roll(k, i)), i(i)
+{
+}
+
 /* Farfalle */
 Farfalle::Farfalle(BaseIterableTransformation &p_b,
                    BaseIterableTransformation &p_c,
@@ -52,51 +170,313 @@ Farfalle::Farfalle(BaseIterableTransformation &p_b,
 		"This implementation only supports permutation width that are multiple of 8."); // Limitation of Transformation class
 }
 
-BitString Farfalle::operator()(const BitString &K, const BitStrings &Mseq, unsigned int n, unsigned int q) const
+BitString Farfalle::operator()(const BitString &K, const BitStrings &Mseq, UINT64 n, UINT64 q, ThreadPool *pool) const
+{
+	FarfalleState S = start(K);
+
+	for (size_t j = 0; j < Mseq.size(); j++)
+	{
+		compress(S, Mseq[j], pool);
+	}
+
+	return expand(S, n, q, pool);
+}
+
+FarfalleState Farfalle::start(const BitString &K) const
 {
 	unsigned int b = width();
 	if (!(K.size() <= b - 1)) throw Exception("Key length must be less than b bits");
-	unsigned int m = Mseq.size();
 
+	FarfalleState S;
 	BitString Kp = K || BitString::pad10(b, K.size());
-	BitString k = p_b(Kp);
+	S.kI = p_b(Kp);
+	S.x = BitString::zeroes(b);
+	S.I = 0;
+	return S;
+}
+
+/*
+ * Compresses M into S
+ *
+ * The accumulator is the xor of independent terms p_c(m_l ^ roll_c(k, S.I + l)). Given a
+ * pool, ranges of ChunkBlocks blocks are handed to its threads: each one jumps the roll to
+ * the start of its range and accumulates a partial x, and the partials are xored at the end.
+ */
+void Farfalle::compress(FarfalleState &S, const BitString &M, ThreadPool *pool) const
+{
+	unsigned int b = width();
+	UINT64 mu = M.size() / b + 1;
+	const Blocks mblocks(M, b);                                      // All blocks but the last are complete and used in place
+	BitString last = BitString::substring(M, (mu - 1) * b, b) || BitString::pad10(b, M.size());
 
-	BitString    x = BitString::zeroes(b);
-	unsigned int I = 0;
+	if (pool == NULL || pool->size() == 1 || mu <= ChunkBlocks)
+	{
+		RollingIterator ki(roll_c, S.kI);                            // roll_c(k, S.I + l) at block l
 
-	for (unsigned int j = 0; j <= m - 1; j++)
+		compressBlocks(mblocks, last, mu, ki, mu, S.x);
+		++ki;                                                        // Index S.I + mu is not used
+		S.kI = *ki;
+	}
+	else
 	{
-		unsigned int mu = (Mseq[j].size() + b) / b;
-		BitString M = Mseq[j] || BitString::pad10(mu * b, Mseq[j].size());
-		Blocks mblocks(M, b);
+		std::vector<BitString> partials((size_t)((mu + ChunkBlocks - 1) / ChunkBlocks), BitString::zeroes(b));
+		std::vector<std::function<void()> > tasks;
 
-		for (unsigned int i = I; i <= I + mu - 1; i++)
+		for (UINT64 j = 0; j < mu; j += ChunkBlocks)
 		{
-			x = x ^ p_c(mblocks[i - I] ^ roll_c(k, i));
+			UINT64 end = std::min(mu, j + ChunkBlocks);
+			BitString *x = &partials[(size_t)(j / ChunkBlocks)];
+			tasks.push_back([&, j, end, x] { RollingIterator ki(roll_c, S.kI, j); compressBlocks(mblocks, last, mu, ki, end, *x); });
 		}
 
-		I = I + mu + 1;
-	}
+		pool->run(tasks);
 
-	BitString kp = roll_c(k, I);
-	BitString y = p_d(x);
+		for (size_t c = 0; c < partials.size(); c++)
+		{
+			S.x = S.x ^ partials[c];
+		}
+		S.kI = roll_c(S.kI, mu + 1);
+	}
 
-	Blocks zblocks(width());
+	S.I = S.I + mu + 1;
+}
 
-	for (unsigned int j = 0; width() * j < n + q; j++)
+/* Xors into x the terms of the blocks ki.index() to end - 1 of the mu blocks of M, the last one being given padded */
+void Farfalle::compressBlocks(const Blocks &mblocks, const BitString &last, UINT64 mu, RollingIterator &ki, UINT64 end, BitString &x) const
+{
+	while (ki.index() < end)
 	{
-		zblocks[j] = p_e(roll_e(y, j)) ^ kp;
+		std::vector<BitString> states;
+
+		for (UINT64 l = ki.index(); l < end && states.size() < BatchSize; l++, ++ki)
+		{
+			if (l < mu - 1) states.push_back(mblocks[l] ^ *ki);
+			else            states.push_back(last ^ *ki);
+		}
+
+		p_c.applyAll(states);
+
+		for (size_t l = 0; l < states.size(); l++)
+		{
+			x = x ^ states[l];
+		}
 	}
+}
+
+BitString Farfalle::expand(const FarfalleState &S, UINT64 n, UINT64 q, ThreadPool *pool) const
+{
+	if (!(n <= ~(UINT64)0 - q)) throw Exception("n + q must fit on 64 bits");
+
+	UINT64    shift = q % 8;                                         // expandTo() starts on a byte
+	BitString Z = BitString::zeroes(8 * ((n + shift + 7) / 8));
 
-	BitString Z = BitString::substring(zblocks.bits(), q, n);
+	expandTo(S, Z.array(), n + shift, q - shift, pool);
+	if (shift) return BitString::substring(Z, shift, n);
+	Z.truncate(n);
 	return Z;
 }
 
+/*
+ * Writes the n output bits from offset q to the (n + 7) / 8 bytes at Z
+ *
+ * Only the blocks holding these bits are computed. roll_e being an iterated function,
+ * roll_e(roll_e(y, i), j) == roll_e(y, i + j): the first block is reached in one call and
+ * each following one in a single step. Given a pool, the rolling states are chained ahead
+ * and ranges of ChunkBlocks blocks are handed to its threads, each writing its own part of Z.
+ */
+void Farfalle::expandTo(const FarfalleState &S, UINT8 *Z, UINT64 n, UINT64 q, ThreadPool *pool) const
+{
+	unsigned int b = width();
+	if (!(n <= ~(UINT64)0 - q)) throw Exception("n + q must fit on 64 bits");
+	if (!(q % 8 == 0)) throw Exception("q must be a multiple of 8");
+	if (n == 0) return;
+
+	const BitString &kp = S.kI;
+	BitString y = p_d(S.x);
+
+	UINT64 first = q / b;
+	UINT64 nz = (n + q) / b + ((n + q) % b != 0);                  // End of the output blocks
+	BitString yl = roll_e(y, first);
+
+	if (pool == NULL || pool->size() == 1 || nz - first <= ChunkBlocks)
+	{
+		expandBlocks(kp, yl, first, nz, Z, n, q);
+	}
+	else
+	{
+		std::vector<std::function<void()> > tasks;
+
+		for (UINT64 j = first; j < nz; j += ChunkBlocks)
+		{
+			UINT64 end = std::min(nz, j + ChunkBlocks);
+			tasks.push_back([=] { expandBlocks(kp, yl, j, end, Z, n, q); });
+			yl = roll_e(yl, end - j);
+		}
+
+		pool->run(tasks);
+	}
+
+	if (n % 8) Z[(n - 1) / 8] &= (1 << (n % 8)) - 1;
+}
+
+/* Writes the output blocks begin to end - 1 to their place in Z, given yl = roll_e(y, begin) */
+void Farfalle::expandBlocks(const BitString &kp, BitString yl, UINT64 begin, UINT64 end, UINT8 *Z, UINT64 n, UINT64 q) const
+{
+	unsigned int b = width();
+
+	for (UINT64 j = begin; j < end; j += BatchSize)
+	{
+		std::vector<BitString> states;
+
+		for (UINT64 l = j; l < end && l < j + BatchSize; l++)
+		{
+			states.push_back(yl);
+			roll_e.step(yl);
+		}
+
+		p_e.applyAll(states);
+
+		for (size_t l = 0; l < states.size(); l++)
+		{
+			BitString z = states[l] ^ kp;
+			UINT64 start = (j + l) * b;                              // Position of the block in the output from offset 0
+			UINT64 from = std::max(start, q);
+			UINT64 to = std::min(start + b, q + n);
+			memcpy(Z + (from - q) / 8, z.array() + (from - start) / 8, (size_t)((to - from + 7) / 8));
+		}
+	}
+}
+
 unsigned int Farfalle::width() const
 {
 	return p_b.width;
 }
 
+/* FarfalleAccumulator */
+FarfalleAccumulator::FarfalleAccumulator(const Farfalle &F, const BitString &K)
+	: F(F), S(F.start(K))
+{
+}
+
+FarfalleAccumulator::FarfalleAccumulator(const Farfalle &F, const FarfalleState &S)
+	: F(F), S(S)
+{
+}
+
+FarfalleAccumulator &FarfalleAccumulator::append(const BitString &M, ThreadPool *pool)
+{
+	F.compress(S, M, pool);
+	return *this;
+}
+
+FarfalleAccumulator FarfalleAccumulator::fork() const
+{
+	return *this;
+}
+
+BitString FarfalleAccumulator::expand(UINT64 n, UINT64 q, ThreadPool *pool) const
+{
+	return F.expand(S, n, q, pool);
+}
+
+const FarfalleState &FarfalleAccumulator::state() const
+{
+	return S;
+}
+
+/* FarfalleKeyed */
+FarfalleKeyed::FarfalleKeyed(const Farfalle &F, const BitString &K)
+	: F(F), key(F.start(K))
+{
+}
+
+FarfalleKeyed::FarfalleKeyed(const Farfalle &F, const FarfalleState &key)
+	: F(F), key(key)
+{
+}
+
+BitString FarfalleKeyed::operator()(const BitStrings &Mseq, UINT64 n, UINT64 q) const
+{
+	FarfalleState S = key;
+
+	for (size_t j = 0; j < Mseq.size(); j++)
+	{
+		F.compress(S, Mseq[j]);
+	}
+
+	return F.expand(S, n, q);
+}
+
+FarfalleAccumulator FarfalleKeyed::accumulator() const
+{
+	return FarfalleAccumulator(F, key);
+}
+
+/* FarfalleKeyCache */
+FarfalleKeyCache::FarfalleKeyCache(const Farfalle &F, size_t capacity)
+	: F(F), capacity(capacity)
+{
+}
+
+FarfalleKeyCache::FarfalleKeyCache(const FarfalleKeyCache &C)
+	: F(C.F), capacity(C.capacity)
+{
+}
+
+static void wipe(std::pair<BitString, FarfalleState> &entry)
+{
+	entry.first.wipe();
+	entry.second.kI.wipe();
+	entry.second.x.wipe();
+}
+
+FarfalleKeyCache::~FarfalleKeyCache()
+{
+	for (std::list<std::pair<BitString, FarfalleState> >::iterator i = entries.begin(); i != entries.end(); ++i)
+	{
+		wipe(*i);
+	}
+}
+
+/* Every entry is compared in full, so the time does not depend on the key */
+const FarfalleState *FarfalleKeyCache::find(const BitString &K)
+{
+	std::list<std::pair<BitString, FarfalleState> >::iterator found = entries.end();
+
+	for (std::list<std::pair<BitString, FarfalleState> >::iterator i = entries.begin(); i != entries.end(); ++i)
+	{
+		if (equalsConstantTime(i->first, K)) found = i;
+	}
+	if (found == entries.end()) return NULL;
+
+	entries.splice(entries.begin(), entries, found);
+	return &found->second;
+}
+
+FarfalleKeyed FarfalleKeyCache::operator()(const BitString &K)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		const FarfalleState *cached = find(K);
+
+		if (cached != NULL) return FarfalleKeyed(F, *cached);
+	}
+
+	FarfalleState S = F.start(K);                                    // Not under the lock
+
+	std::lock_guard<std::mutex> guard(lock);
+	const FarfalleState *cached = find(K);                           // Another thread may have inserted K meanwhile
+
+	if (cached != NULL) return FarfalleKeyed(F, *cached);
+	entries.push_front(std::make_pair(K, S));
+	if (entries.size() > capacity)
+	{
+		wipe(entries.back());
+		entries.pop_back();
+	}
+	return FarfalleKeyed(F, S);
+}
+
 /* Farfalle-SANE */
 FarfalleSANE::FarfalleSANE(const Farfalle  &F,
                          unsigned int     t,
@@ -105,11 +485,11 @@ FarfalleSANE::FarfalleSANE(const Farfalle  &F,
                          const BitString &N,
                          BitString &T,
                          bool sender)
-	: F(F), t(t), l(l), K(K), e(0)
+	: F(F), t(t), l(l), history(F.start(K)), e(0)
 {
 	offset = l * ((t + l - 1) / l);
-	history = N;
-	BitString Tp = F(K, history, t);
+	F.compress(history, N);
+	BitString Tp = F.expand(history, t);
 
 	if (sender)
 	{
@@ -123,38 +503,38 @@ FarfalleSANE::FarfalleSANE(const Farfalle  &F,
 
 std::pair<BitString, BitString> FarfalleSANE::wrap(const BitString &A, const BitString &P)
 {
-	BitString C = P ^ F(K, history, P.size(), offset);
+	BitString C = P ^ F.expand(history, P.size(), offset);
 
 	if (A.size() > 0 || P.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.compress(history, A || 0 || e);
 	}
 
 	if (P.size() > 0)
 	{
-		history = (C || 1 || e) * history;
+		F.compress(history, C || 1 || e);
 	}
 
-	BitString T = F(K, history, t);
+	BitString T = F.expand(history, t);
 	e = (e + 1) % 2;
 	return std::make_pair(C, T);
 }
 
 BitString FarfalleSANE::unwrap(const BitString &A, const BitString &C, const BitString &T)
 {
-	BitString P = C ^ F(K, history, C.size(), offset);
+	BitString P = C ^ F.expand(history, C.size(), offset);
 
 	if (A.size() > 0 || C.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.compress(history, A || 0 || e);
 	}
 
 	if (C.size() > 0)
 	{
-		history = (C || 1 || e) * history;
+		F.compress(history, C || 1 || e);
 	}
 
-	BitString Tp = F(K, history, t);
+	BitString Tp = F.expand(history, t);
 	e = (e + 1) % 2;
 
 	if (Tp == T)
@@ -171,7 +551,7 @@ BitString FarfalleSANE::unwrap(const BitString &A, const BitString &C, const Bit
 FarfalleSANSE::FarfalleSANSE(const Farfalle  &F,
                          unsigned int     t,
                          const BitString &K)
-	: F(F), t(t), K(K), e(0)
+	: F(F), t(t), history(F.start(K)), e(0)
 {
 }
 
@@ -179,20 +559,22 @@ std::pair<BitString, BitString> FarfalleSANSE::wrap(const BitString &A, const Bi
 {
 	if (A.size() > 0 || P.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.compress(history, A || 0 || e);
 	}
 
 	BitString T, C;
 
 	if (P.size() > 0)
 	{
-		T =     F(K, (P || 0 || 1 || e) * history, t);
-		C = P ^ F(K, (T || 1 || 1 || e) * history, P.size());
-		history = (P || 0 || 1 || e) * history;
+		FarfalleState withT = history;
+		F.compress(history, P || 0 || 1 || e);
+		T = F.expand(history, t);
+		F.compress(withT, T || 1 || 1 || e);
+		C = P ^ F.expand(withT, P.size());
 	}
 	else
 	{
-		T = F(K, history, t);
+		T = F.expand(history, t);
 	}
 
 	e = (e + 1) % 2;
@@ -203,18 +585,20 @@ BitString FarfalleSANSE::unwrap(const BitString &A, const BitString &C, const Bi
 {
 	if (A.size() > 0 || C.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.compress(history, A || 0 || e);
 	}
 
 	BitString P;
 
 	if (C.size() > 0)
 	{
-		P = C ^ F(K, (T || 1 || 1 || e) * history, C.size());
-		history = (P || 0 || 1 || e) * history;
+		FarfalleState withT = history;
+		F.compress(withT, T || 1 || 1 || e);
+		P = C ^ F.expand(withT, C.size());
+		F.compress(history, P || 0 || 1 || e);
 	}
 
-	BitString Tp = F(K, history, t);
+	BitString Tp = F.expand(history, t);
 	e = (e + 1) % 2;
 
 	if (Tp == T)
@@ -227,18 +611,35 @@ BitString FarfalleSANSE::unwrap(const BitString &A, const BitString &C, const Bi
 	}
 }
 
+/* FarfalleWBCKeys */
+FarfalleWBCKeys::FarfalleWBCKeys(const Farfalle &H, const Farfalle &G, size_t capacity)
+	: H(H, capacity), G(G, capacity)
+{
+}
+
 /* Farfalle-WBC */
 FarfalleWBC::FarfalleWBC(const Farfalle  &H,
                          const Farfalle  &G,
-                         unsigned int     l)
-	: H(H), G(G), l(l)
+                         unsigned int     l,
+                         FarfalleWBCKeys *keys)
+	: H(H), G(G), l(l), keys(keys)
+{
+}
+
+FarfalleKeyed FarfalleWBC::keyedH(const BitString &K) const
+{
+	return (keys != NULL) ? keys->H(K) : FarfalleKeyed(H, K);
+}
+
+FarfalleKeyed FarfalleWBC::keyedG(const BitString &K) const
 {
+	return (keys != NULL) ? keys->G(K) : FarfalleKeyed(G, K);
 }
 
-unsigned int FarfalleWBC::split(unsigned int n) const
+UINT64 FarfalleWBC::split(UINT64 n) const
 {
 	unsigned int b = H.width();
-	unsigned int n_L;
+	UINT64 n_L;
 
 	if (n <= 2 * b - (l + 2))
 	{
@@ -246,8 +647,8 @@ unsigned int FarfalleWBC::split(unsigned int n) const
 	}
 	else
 	{
-		unsigned int q = (n + l + 1 + b) / b;
-		unsigned int tx = 1;
+		UINT64 q = (n + l + 1 + b) / b;
+		UINT64 tx = 1;
 		while ((tx << 1) < q) tx <<= 1;
 		n_L = (q - tx) * b - l;
 	}
@@ -258,17 +659,18 @@ unsigned int FarfalleWBC::split(unsigned int n) const
 BitString FarfalleWBC::encipher(const BitString &K, const BitString &W, const BitString &P) const
 {
 	unsigned int b = H.width();
+	FarfalleKeyed HK = keyedH(K), GK = keyedG(K);
 
-	unsigned int n_L = split(P.size());
-	unsigned int n_R = P.size() - n_L;
+	UINT64 n_L = split(P.size());
+	UINT64 n_R = P.size() - n_L;
 	BitString L = BitString::substring(P, 0, n_L);
 	BitString R = BitString::substring(P, n_L, n_R);
 
-	BitString Hval = H(K, (L || 0), std::min(b, R.size()));
+	BitString Hval = HK((L || 0), std::min<UINT64>(b, R.size()));
 	R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
-	L = L ^ G(K, (R || 1) * W, L.size());
-	R = R ^ G(K, (L || 0) * W, R.size());
-	Hval = H(K, (R || 1), std::min(b, L.size()));
+	L = L ^ GK((R || 1) * W, L.size());
+	R = R ^ GK((L || 0) * W, R.size());
+	Hval = HK((R || 1), std::min<UINT64>(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
 	return L || R;
 }
@@ -276,17 +678,18 @@ BitString FarfalleWBC::encipher(const BitString &K, const BitString &W, const Bi
 BitString FarfalleWBC::decipher(const BitString &K, const BitString &W, const BitString &C) const
 {
 	unsigned int b = H.width();
+	FarfalleKeyed HK = keyedH(K), GK = keyedG(K);
 
-	unsigned int n_L = split(C.size());
-	unsigned int n_R = C.size() - n_L;
+	UINT64 n_L = split(C.size());
+	UINT64 n_R = C.size() - n_L;
 	BitString L = BitString::substring(C, 0, n_L);
 	BitString R = BitString::substring(C, n_L, n_R);
 
-	BitString Hval = H(K, (R || 1), std::min(b, L.size()));
+	BitString Hval = HK((R || 1), std::min<UINT64>(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
-	R = R ^ G(K, (L || 0) * W, R.size());
-	L = L ^ G(K, (R || 1) * W, L.size());
-	Hval = H(K, (L || 0), std::min(b, R.size()));
+	R = R ^ GK((L || 0) * W, R.size());
+	L = L ^ GK((R || 1) * W, L.size());
+	Hval = HK((L || 0), std::min<UINT64>(b, R.size()));
 	R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
 	return L || R;
 }
@@ -295,8 +698,9 @@ BitString FarfalleWBC::decipher(const BitString &K, const BitString &W, const Bi
 FarfalleWBCAE::FarfalleWBCAE(const Farfalle  &H,
                              const Farfalle  &G,
                              unsigned int     t,
-                             unsigned int     l)
-	: FarfalleWBC(H, G, l), t(t)
+                             unsigned int     l,
+                             FarfalleWBCKeys *keys)
+	: FarfalleWBC(H, G, l, keys), t(t)
 {
 }
 
@@ -309,29 +713,30 @@ BitString FarfalleWBCAE::wrap(const BitString &K, const BitString &A, const BitS
 BitString FarfalleWBCAE::unwrap(const BitString &K, const BitString &A, const BitString &C) const
 {
 	unsigned int b = H.width();
+	FarfalleKeyed HK = keyedH(K), GK = keyedG(K);
 
-	unsigned int n_L = split(C.size());
-	unsigned int n_R = C.size() - n_L;
+	UINT64 n_L = split(C.size());
+	UINT64 n_R = C.size() - n_L;
 	BitString L = BitString::substring(C, 0, n_L);
 	BitString R = BitString::substring(C, n_L, n_R);
 
-	BitString Hval = H(K, (R || 1), std::min(b, L.size()));
+	BitString Hval = HK((R || 1), std::min<UINT64>(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
-	R = R ^ G(K, (L || 0) * A, R.size());
+	R = R ^ GK((L || 0) * A, R.size());
 
 	if (R.size() >= b + t)
 	{
 		if (!(BitString::substring(R, R.size() - t, t) == BitString::zeroes(t))) throw Exception("error!");
-		L = L ^ G(K, (R || 1) * A, L.size());
-		Hval = H(K, (L || 0), b);
+		L = L ^ GK((R || 1) * A, L.size());
+		Hval = HK((L || 0), b);
 		R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
 	}
 	else
 	{
-		L = L ^ G(K, (R || 1) * A, L.size());
-		Hval = H(K, (L || 0), std::min(b, R.size()));
+		L = L ^ GK((R || 1) * A, L.size());
+		Hval = HK((L || 0), std::min<UINT64>(b, R.size()));
 		R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
-		if (!(BitString::substring(L || R, C.size() - t, t) == BitString::zeroes(t))) throw Exception("error!");
+		if (!(BitString::substring(BitString(L || R), C.size() - t, t) == BitString::zeroes(t))) throw Exception("error!");
 	}
 
 	BitString Pp = L || R;
@@ -12,8 +12,13 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _FARFALLE_H_
 #define _FARFALLE_H_
 
+#include <atomic>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "bitstring.h"
 #include "transformations.h"
@@ -21,17 +26,84 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 /**
  * Class implementing a rolling function
+ *
+ * roll(k, i) applies i times the same step to k, so roll(roll(k, i), j) == roll(k, i + j).
  */
 class BaseRollingFunction
 {
 	public:
-		virtual BitString operator()(const BitString &k, unsigned int i) const = 0;
+		virtual BitString operator()(const BitString &k, UINT64 i) const = 0;
+		virtual void      step(BitString &k) const;                  // k = roll(k, 1), in place
 };
 
 class IdentityRollingFunction : public BaseRollingFunction
 {
 	public:
-		BitString operator()(const BitString &k, unsigned int i) const;
+		BitString operator()(const BitString &k, UINT64 i) const;
+		void      step(BitString &k) const;
+};
+
+/**
+ * Class implementing a rolling function whose step is linear over GF(2)
+ *
+ * Subclasses only define the step, on width-bit states. roll(k, i) is M^i k
+ * for the matrix M of the step: beyond a few steps, it is computed with
+ * the binary decomposition of i, from the powers M^(2^j). Each power is
+ * obtained by squaring the first time it is needed and then kept.
+ */
+class LinearRollingFunction : public BaseRollingFunction
+{
+	public:
+		static const UINT64 JumpThreshold = 256;                     // Smaller i are stepped through
+
+	protected:
+		const unsigned int            width;
+		const unsigned int            words;                         // 64-bit words per state
+		mutable std::vector<UINT64>   powers[64];                    // powers[j][words*r ...]: M^(2^j) applied to bit r
+		mutable std::atomic<unsigned int>  levels;                   // Number of powers available
+		mutable std::mutex            lock;                          // Guards the computation of powers
+
+		const std::vector<UINT64> &power(unsigned int j) const;
+		void  apply(const std::vector<UINT64> &M, const UINT64 *v, UINT64 *out) const;
+
+	public:
+		LinearRollingFunction(unsigned int width);
+		BitString operator()(const BitString &k, UINT64 i) const;
+		virtual void step(BitString &k) const = 0;
+};
+
+/**
+ * Class iterating a rolling function: *it is roll(k, i) and ++it moves to i + 1 in one step
+ */
+class RollingIterator
+{
+	protected:
+		const BaseRollingFunction &roll;
+		BitString                  k;
+		UINT64                     i;
+
+	public:
+		RollingIterator(const BaseRollingFunction &roll, const BitString &k, UINT64 i = 0);  // Starts at roll(k, i)
+		const BitString &operator*() const { return k; }
+		UINT64           index() const { return i; }
+		RollingIterator &operator++() { roll.step(k); i++; return *this; }
+};
+
+class ThreadPool;
+
+/**
+ * Class holding the state of Farfalle after compressing a sequence of strings
+ *
+ * Compressing M_0, ..., M_m-1 and then M_m gives the same state as
+ * compressing M_0, ..., M_m at once, so a sequence can be extended without
+ * being compressed again.
+ */
+class FarfalleState
+{
+	public:
+		BitString kI;                                                // Masked key rolled to the next block: roll_c(k, I)
+		BitString x;                                                 // Accumulator
+		UINT64    I;                                                 // Index of the next block
 };
 
 /**
@@ -47,12 +119,84 @@ class Farfalle
 		BaseRollingFunction        &roll_c;
 		BaseRollingFunction        &roll_e;
 
+		void          compressBlocks(const Blocks &mblocks, const BitString &last, UINT64 mu, RollingIterator &ki, UINT64 end, BitString &x) const;
+		void          expandBlocks(const BitString &kp, BitString yl, UINT64 begin, UINT64 end, UINT8 *Z, UINT64 n, UINT64 q) const;
+
 	public:
 		Farfalle(BaseIterableTransformation &p_b, BaseIterableTransformation &p_c, BaseIterableTransformation &p_d, BaseIterableTransformation &p_e, BaseRollingFunction &roll_c, BaseRollingFunction &roll_e);
-		BitString     operator()(const BitString &K, const BitStrings &Mseq, unsigned int n, unsigned int q = 0) const;
+		BitString     operator()(const BitString &K, const BitStrings &Mseq, UINT64 n, UINT64 q = 0, ThreadPool *pool = NULL) const;
+		FarfalleState start(const BitString &K) const;
+		void          compress(FarfalleState &S, const BitString &M, ThreadPool *pool = NULL) const;
+		BitString     expand(const FarfalleState &S, UINT64 n, UINT64 q = 0, ThreadPool *pool = NULL) const;
+		void          expandTo(const FarfalleState &S, UINT8 *Z, UINT64 n, UINT64 q = 0, ThreadPool *pool = NULL) const;  // q multiple of 8
 		unsigned int  width() const;
 };
 
+/**
+ * Class implementing an incremental Farfalle computation
+ *
+ * Appending M_0, ..., M_m-1 and expanding gives F(K, M_m-1 o ... o M_0, n, q).
+ * fork() copies the compressed state, so a common prefix is compressed once
+ * and then continued with different suffixes.
+ */
+class FarfalleAccumulator
+{
+	protected:
+		Farfalle      F;
+		FarfalleState S;
+
+	public:
+		FarfalleAccumulator(const Farfalle &F, const BitString &K);
+		FarfalleAccumulator(const Farfalle &F, const FarfalleState &S);
+		FarfalleAccumulator &  append(const BitString &M, ThreadPool *pool = NULL);
+		FarfalleAccumulator    fork() const;
+		BitString              expand(UINT64 n, UINT64 q = 0, ThreadPool *pool = NULL) const;
+		const FarfalleState &  state() const;
+};
+
+/**
+ * Class implementing Farfalle under a fixed key, whose setup is done once
+ */
+class FarfalleKeyed
+{
+	protected:
+		Farfalle      F;
+		FarfalleState key;                                           // State after start(K)
+
+	public:
+		FarfalleKeyed(const Farfalle &F, const BitString &K);
+		FarfalleKeyed(const Farfalle &F, const FarfalleState &key);
+		BitString     operator()(const BitStrings &Mseq, UINT64 n, UINT64 q = 0) const;
+		FarfalleAccumulator  accumulator() const;
+};
+
+/**
+ * Class implementing a least-recently-used cache of key setups
+ *
+ * It maps K to F.start(K) for the last capacity keys used. Lookups may be
+ * made from several threads. A copy starts with an empty cache. Keys are
+ * compared in constant time, and wiped along with their setup once evicted.
+ */
+class FarfalleKeyCache
+{
+	public:
+		static const size_t DefaultCapacity = 16;
+
+	protected:
+		Farfalle                                        F;
+		size_t                                          capacity;
+		std::list<std::pair<BitString, FarfalleState> > entries;     // Most recently used first
+		std::mutex                                      lock;
+
+		const FarfalleState *  find(const BitString &K);               // Moves K to the front; under the lock
+
+	public:
+		FarfalleKeyCache(const Farfalle &F, size_t capacity = DefaultCapacity);
+		FarfalleKeyCache(const FarfalleKeyCache &C);
+		~FarfalleKeyCache();
+		FarfalleKeyed  operator()(const BitString &K);
+};
+
 /**
  * Class implementing Farfalle-SANE
  */
@@ -62,8 +206,7 @@ class FarfalleSANE
 		Farfalle           F;
 		const unsigned int t;
 		const unsigned int l;
-		BitString          K;
-		BitStrings         history;
+		FarfalleState      history;                                  // Compressed N and the messages so far
 		unsigned int       offset;
 		unsigned int       e;
 
@@ -81,8 +224,7 @@ class FarfalleSANSE
 	private:
 		Farfalle           F;
 		const unsigned int t;
-		BitString          K;
-		BitStrings         history;
+		FarfalleState      history;                                  // Compressed messages so far
 		unsigned int       e;
 
 	public:
@@ -91,6 +233,21 @@ class FarfalleSANSE
 		BitString                        unwrap(const BitString &A, const BitString &C, const BitString &T);
 };
 
+/**
+ * Class holding the key setups of Farfalle-WBC, for the H and G it is built with
+ *
+ * The caller owns it and may share it between any number of WBC and WBC-AE
+ * objects using the same H and G, including from several threads.
+ */
+class FarfalleWBCKeys
+{
+	public:
+		FarfalleKeyCache   H;
+		FarfalleKeyCache   G;
+
+		FarfalleWBCKeys(const Farfalle &H, const Farfalle &G, size_t capacity = FarfalleKeyCache::DefaultCapacity);
+};
+
 /**
  * Class implementing Farfalle-WBC
  */
@@ -100,11 +257,14 @@ class FarfalleWBC
 		Farfalle           H;
 		Farfalle           G;
 		const unsigned int l;
+		FarfalleWBCKeys *  keys;                                     // Cached key setups, or NULL to set each key up anew
 
-		unsigned int split(unsigned int n) const;
+		UINT64 split(UINT64 n) const;
+		FarfalleKeyed keyedH(const BitString &K) const;
+		FarfalleKeyed keyedG(const BitString &K) const;
 
 	public:
-		FarfalleWBC(const Farfalle &H, const Farfalle &G, unsigned int l);
+		FarfalleWBC(const Farfalle &H, const Farfalle &G, unsigned int l, FarfalleWBCKeys *keys = NULL);
 		BitString  encipher(const BitString &K, const BitString &W, const BitString &P) const;
 		BitString  decipher(const BitString &K, const BitString &W, const BitString &C) const;
 };
@@ -118,7 +278,7 @@ class FarfalleWBCAE : public FarfalleWBC
 		const unsigned int t;
 
 	public:
-		FarfalleWBCAE(const Farfalle &H, const Farfalle &G, unsigned int t, unsigned int l);
+		FarfalleWBCAE(const Farfalle &H, const Farfalle &G, unsigned int t, unsigned int l, FarfalleWBCKeys *keys = NULL);
 		BitString  wrap(const BitString &K, const BitString &A, const BitString &P) const;
 		BitString  unwrap(const BitString &K, const BitString &A, const BitString &C) const;
 };
@@ -931,8 +931,125 @@ void writeTestXoofffWBCAE(const char *filename)
 #endif
 
 /* ------------------------------------------------------------------------- */
+
+/*
+ * SANE and SANSE as specified, calling Xoofff on the whole history each time. The sessions keep
+ * a compressed history instead, and must give the same outputs message after message.
+ */
+class ReferenceSANE
+{
+    private:
+        Xoofff             F;
+        const unsigned int t;
+        unsigned int       offset;
+        unsigned int       e;
+        BitString          K;
+        BitStrings         history;
+
+    public:
+        ReferenceSANE(unsigned int t, unsigned int l, const BitString &K, const BitString &N, BitString &T)
+            : t(t), offset(l * ((t + l - 1) / l)), e(0), K(K), history(N)
+        {
+            T = F(K, history, t);
+        }
+
+        std::pair<BitString, BitString> wrap(const BitString &A, const BitString &P)
+        {
+            BitString C = P ^ F(K, history, P.size(), offset);
+
+            if (A.size() > 0 || P.size() == 0) history = (A || 0 || e) * history;
+            if (P.size() > 0) history = (C || 1 || e) * history;
+            e = (e + 1) % 2;
+            return std::make_pair(C, F(K, history, t));
+        }
+};
+
+class ReferenceSANSE
+{
+    private:
+        Xoofff             F;
+        const unsigned int t;
+        unsigned int       e;
+        BitString          K;
+        BitStrings         history;
+
+    public:
+        ReferenceSANSE(unsigned int t, const BitString &K)
+            : t(t), e(0), K(K)
+        {
+        }
+
+        std::pair<BitString, BitString> wrap(const BitString &A, const BitString &P)
+        {
+            BitString T, C;
+
+            if (A.size() > 0 || P.size() == 0) history = (A || 0 || e) * history;
+            if (P.size() > 0) {
+                T = F(K, (P || 0 || 1 || e) * history, t);
+                C = P ^ F(K, (T || 1 || 1 || e) * history, P.size());
+                history = (P || 0 || 1 || e) * history;
+            }
+            else {
+                T = F(K, history, t);
+            }
+            e = (e + 1) % 2;
+            return std::make_pair(C, T);
+        }
+};
+
+/* Messages of a session: empty AD and plaintext alone and together, bit lengths, and more than two blocks */
+static const unsigned int sessionLengths[][2] = {
+    { 0, 0 }, { 0, 0 }, { 100, 0 }, { 0, 77 }, { 8, 8 }, { 0, 5 * XnP_width + 3 }, { 3 * XnP_width, 0 }, { 1, 1000 }, { 0, 0 }, { 500, 2 * XnP_width }
+};
+
+static BitString sessionString(unsigned int length, unsigned char seed)
+{
+    unsigned char data[ADByteSize];
+
+    generateSimpleRawMaterial(data, (length + 7) / 8, seed, length);
+    return BitString(data, length);
+}
+
+static void performTestXoofffSANEBaseline(void)
+{
+    const BitString K = sessionString(256, 0x11), N = sessionString(200, 0x22);
+    BitString Tsender, Treference;
+    ReferenceSANE reference(tagLenSANE * 8, 8, K, N, Treference);
+    XoofffSANE sender(K, N, Tsender, true);
+    XoofffSANE receiver(K, N, Treference, false);
+
+    assert(Tsender == Treference);
+    for (unsigned int i = 0; i < sizeof(sessionLengths) / sizeof(sessionLengths[0]); i++) {
+        BitString A = sessionString(sessionLengths[i][0], (unsigned char)(3 * i)), P = sessionString(sessionLengths[i][1], (unsigned char)(5 * i + 1));
+        std::pair<BitString, BitString> expected = reference.wrap(A, P);
+        std::pair<BitString, BitString> CT = sender.wrap(A, P);
+
+        assert(CT.first == expected.first && CT.second == expected.second);
+        assert(receiver.unwrap(A, expected.first, expected.second) == P);
+    }
+}
+
+static void performTestXoofffSANSEBaseline(void)
+{
+    const BitString K = sessionString(256, 0x33);
+    ReferenceSANSE reference(tagLenSANSE * 8, K);
+    XoofffSANSE sender(K), receiver(K);
+
+    for (unsigned int i = 0; i < sizeof(sessionLengths) / sizeof(sessionLengths[0]); i++) {
+        BitString A = sessionString(sessionLengths[i][0], (unsigned char)(7 * i)), P = sessionString(sessionLengths[i][1], (unsigned char)(9 * i + 2));
+        std::pair<BitString, BitString> expected = reference.wrap(A, P);
+        std::pair<BitString, BitString> CT = sender.wrap(A, P);
+
+        assert(CT.first == expected.first && CT.second == expected.second);
+        assert(receiver.unwrap(A, expected.first, expected.second) == P);
+    }
+}
+
 void testXooModes(void)
 {
+    performTestXoofffSANEBaseline();
+    performTestXoofffSANSEBaseline();
+
 #ifndef KeccakP1600_excluded
 #ifdef OUTPUT
 //    printXooTestVectors();
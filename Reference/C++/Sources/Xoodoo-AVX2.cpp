@@ -0,0 +1,54 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "Xoodoo-dispatch.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+/* Same as the SSE2 kernel, but VEX-encoded: three-operand forms save the register copies */
+namespace
+{
+	struct Ops
+	{
+		typedef __m128i V;
+
+		static V load(const UINT8 *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+		static void store(UINT8 *p, V a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a); }
+		static V XOR(V a, V b) { return _mm_xor_si128(a, b); }
+		static V ANDNOT(V a, V b) { return _mm_andnot_si128(a, b); }
+		static V lane0(UINT32 c) { return _mm_cvtsi32_si128(static_cast<int>(c)); }
+		template<int n> static V rol(V a) { return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n)); }
+		template<int dx> static V shift(V a) { return _mm_shuffle_epi32(a, ((-dx) & 3) | (((1 - dx) & 3) << 2) | (((2 - dx) & 3) << 4) | (((3 - dx) & 3) << 6)); }
+	};
+
+	#include "Xoodoo-SIMD128.inc"
+}
+
+static void permute(UINT8 *state, const UINT32 *rc, unsigned int rounds)
+{
+	Xoodoo_permute<Ops>(state, rc, rounds);
+}
+
+XoodooKernel getXoodooKernelAVX2()
+{
+	return permute;
+}
+
+#else
+
+XoodooKernel getXoodooKernelAVX2()
+{
+	return NULL;
+}
+
+#endif
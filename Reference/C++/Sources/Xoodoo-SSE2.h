@@ -0,0 +1,39 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _XOODOO_SSE2_H_
+#define _XOODOO_SSE2_H_
+
+#include <vector>
+
+#include "Xoodoo.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define XOODOO_SSE2
+#endif
+
+/**
+ * Class implementing Xoodoo with each plane held in a 128-bit SSE2 register
+ */
+class XoodooSSE2
+{
+	private:
+		std::vector<Lane> rc;
+		unsigned int rounds;
+
+	public:
+		XoodooSSE2(unsigned int width, unsigned int vrounds);
+		void operator()(UINT8 *state) const;
+
+		static bool isAvailable();
+};
+
+#endif
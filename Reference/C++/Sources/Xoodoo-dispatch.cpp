@@ -0,0 +1,170 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Xoodoo-dispatch.h"
+#include "Xoodootimes.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define XOODOO_CPUID
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int r[4])
+{
+	if (!__get_cpuid_count(leaf, subleaf, &r[0], &r[1], &r[2], &r[3])) r[0] = r[1] = r[2] = r[3] = 0;
+}
+static UINT64 xgetbv()
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<UINT64>(edx) << 32) | eax;
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define XOODOO_CPUID
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int r[4])
+{
+	__cpuidex(reinterpret_cast<int *>(r), static_cast<int>(leaf), static_cast<int>(subleaf));
+}
+static UINT64 xgetbv()
+{
+	return _xgetbv(0);
+}
+#endif
+
+static bool cpuSupports(XoodooBackend backend)
+{
+	if (backend == BACKEND_GENERIC) return true;
+
+#if defined(XOODOO_CPUID)
+	unsigned int leaf0[4], leaf1[4], leaf7[4];
+
+	cpuid(0, 0, leaf0);
+	cpuid(1, 0, leaf1);
+	if (leaf0[0] >= 7) cpuid(7, 0, leaf7);
+	else leaf7[0] = leaf7[1] = leaf7[2] = leaf7[3] = 0;
+
+	bool sse2 = (leaf1[3] >> 26) & 1;
+	bool osxsave = (leaf1[2] >> 27) & 1;
+	bool avx = (leaf1[2] >> 28) & 1;
+	UINT64 xcr0 = osxsave ? xgetbv() : 0;
+	bool ymm = (xcr0 & 0x06) == 0x06;                                // XMM and YMM state enabled by the OS
+	bool zmm = (xcr0 & 0xE6) == 0xE6;                                // Idem, plus opmask and ZMM state
+	bool avx2 = avx && ymm && ((leaf7[1] >> 5) & 1);
+	bool avx512 = avx2 && zmm && ((leaf7[1] >> 16) & 1) && ((leaf7[1] >> 31) & 1); // AVX512F and AVX512VL
+
+	switch (backend)
+	{
+		case BACKEND_SSE2:   return sse2;
+		case BACKEND_AVX2:   return avx2;
+		case BACKEND_AVX512: return avx512;
+		default:             return false;
+	}
+#else
+	return false;
+#endif
+}
+
+static bool compiledIn(XoodooBackend backend)
+{
+	switch (backend)
+	{
+		case BACKEND_GENERIC: return true;
+		case BACKEND_SSE2:    return getXoodooKernelSSE2() != NULL && getXoodooTimes4KernelSSE2() != NULL;
+		case BACKEND_AVX2:    return getXoodooKernelAVX2() != NULL && getXoodooTimes8KernelAVX2() != NULL;
+		case BACKEND_AVX512:  return getXoodooKernelAVX512() != NULL && getXoodooTimes16KernelAVX512() != NULL;
+		default:              return false;
+	}
+}
+
+static XoodooBackend initialBackend()
+{
+	const char *name = std::getenv("XOODOO_BACKEND");
+
+	if (name != NULL && *name != '\0')
+	{
+		for (int b = BACKEND_GENERIC; b <= BACKEND_AVX512; b++)
+		{
+			XoodooBackend backend = static_cast<XoodooBackend>(b);
+
+			if (std::strcmp(name, getXoodooBackendName(backend)) == 0)
+			{
+				if (!isXoodooBackendSupported(backend)) throw Exception(std::string("XOODOO_BACKEND: ") + name + " is not supported on this CPU");
+				return backend;
+			}
+		}
+
+		throw Exception(std::string("XOODOO_BACKEND: unknown backend ") + name);
+	}
+
+	for (int b = BACKEND_AVX512; b > BACKEND_GENERIC; b--)
+	{
+		if (isXoodooBackendSupported(static_cast<XoodooBackend>(b))) return static_cast<XoodooBackend>(b);
+	}
+
+	return BACKEND_GENERIC;
+}
+
+static std::atomic<int> &activeBackend()
+{
+	static std::atomic<int> backend(initialBackend());
+	return backend;
+}
+
+bool isXoodooBackendSupported(XoodooBackend backend)
+{
+	static const bool supported[] =
+	{
+		true,
+		cpuSupports(BACKEND_SSE2) && compiledIn(BACKEND_SSE2),
+		cpuSupports(BACKEND_AVX2) && compiledIn(BACKEND_AVX2),
+		cpuSupports(BACKEND_AVX512) && compiledIn(BACKEND_AVX512),
+	};
+
+	return backend >= BACKEND_GENERIC && backend <= BACKEND_AVX512 && supported[backend];
+}
+
+XoodooBackend getXoodooBackend()
+{
+	return static_cast<XoodooBackend>(activeBackend().load(std::memory_order_relaxed));
+}
+
+void setXoodooBackend(XoodooBackend backend)
+{
+	if (!isXoodooBackendSupported(backend)) throw Exception(std::string(getXoodooBackendName(backend)) + " is not supported on this CPU");
+	activeBackend().store(backend, std::memory_order_relaxed);
+}
+
+const char *getXoodooBackendName(XoodooBackend backend)
+{
+	switch (backend)
+	{
+		case BACKEND_GENERIC: return "generic";
+		case BACKEND_SSE2:    return "sse2";
+		case BACKEND_AVX2:    return "avx2";
+		case BACKEND_AVX512:  return "avx512";
+		default:              return "unknown";
+	}
+}
+
+XoodooKernel getXoodooKernel()
+{
+	switch (getXoodooBackend())
+	{
+		case BACKEND_SSE2:   return getXoodooKernelSSE2();
+		case BACKEND_AVX2:   return getXoodooKernelAVX2();
+		case BACKEND_AVX512: return getXoodooKernelAVX512();
+		default:             return NULL;
+	}
+}
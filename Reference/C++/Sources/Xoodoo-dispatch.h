@@ -0,0 +1,51 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _XOODOO_DISPATCH_H_
+#define _XOODOO_DISPATCH_H_
+
+#include "types.h"
+
+/**
+ * Implementations of Xoodoo, from slowest to fastest
+ *
+ * Each backend provides a single-state kernel and, except the generic one,
+ * a parallel XoodooTimes kernel (×4 for SSE2, ×8 for AVX2, ×16 for AVX-512).
+ */
+enum XoodooBackend
+{
+	BACKEND_GENERIC,
+	BACKEND_SSE2,
+	BACKEND_AVX2,
+	BACKEND_AVX512,
+};
+
+/**
+ * Single-state Xoodoo, with the round constants given in order of application
+ */
+typedef void (*XoodooKernel)(UINT8 *state, const UINT32 *rc, unsigned int rounds);
+
+XoodooKernel getXoodooKernelSSE2();                                  // NULL if not compiled in
+XoodooKernel getXoodooKernelAVX2();                                  // Idem
+XoodooKernel getXoodooKernelAVX512();                                // Idem
+
+/**
+ * The active backend is the fastest one supported by the CPU, unless the
+ * environment variable XOODOO_BACKEND (generic, sse2, avx2 or avx512) or
+ * setXoodooBackend() selects another one. It is detected once, on first use.
+ */
+bool           isXoodooBackendSupported(XoodooBackend backend);
+XoodooBackend  getXoodooBackend();
+void           setXoodooBackend(XoodooBackend backend);
+const char *   getXoodooBackendName(XoodooBackend backend);
+XoodooKernel   getXoodooKernel();                                    // NULL for the generic backend
+
+#endif
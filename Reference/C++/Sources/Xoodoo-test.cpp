@@ -0,0 +1,215 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "Xoodoo.h"
+#include "Xoodoo-dispatch.h"
+#include "Xoodoo-SSE2.h"
+#include "Xoodoo-test.h"
+#include "Xoodootimes.h"
+
+/* #define VERBOSE */
+
+#define stateByteSize           48
+#define numberOfStates          1000
+
+#if (defined(VERBOSE) || !defined(EMBEDDED))
+#include <stdio.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(EMBEDDED)
+static void assert(int condition)
+{
+    if (!condition)
+    {
+        for ( ; ; ) ;
+    }
+}
+uint8_t random8( void );
+#define rand    random8
+#else
+#include <assert.h>
+#endif
+
+static void randomize( unsigned char* data, unsigned int length)
+{
+    while (length--)
+    {
+        *data++ = rand();
+    }
+}
+
+/* State after iterating the permutation 1000 times on the all-zero state */
+static const struct
+{
+    unsigned int rounds;
+    UINT32 lanes[12];
+} knownAnswers[] =
+{
+        {  1, { 0x10c0dd75, 0xe49f127f, 0x4d0dfe31, 0x829b725c, 0xa43fd1c2, 0x679be1ea, 0x3fb233b5, 0xea7f4714, 0x9074fcb1, 0x0846151b, 0x2caa62fd, 0xc6e0f393 } },
+        {  6, { 0x6e371085, 0xb313caf6, 0x4293aac2, 0xbd67090c, 0xc49bb6c9, 0x8effa844, 0xfe431a18, 0x16cdd7cf, 0x95ca6562, 0xa7f74f37, 0x9da03d56, 0x844fe23b } },
+        { 12, { 0xed24cf71, 0xd62eea16, 0xc509efaf, 0x50acd728, 0xa5c5812c, 0x9cca0786, 0xdab70ced, 0x18ceeea9, 0xc6813939, 0x5dd879eb, 0x00d36790, 0x280854ee } },
+        { 14, { 0x3330cf49, 0x3a277b1a, 0x84b716a4, 0x370b480b, 0x72a9694e, 0x95036b0e, 0xc2a15425, 0xb7e81410, 0x2adbafae, 0x2ba95996, 0xc16a167c, 0x6da2a818 } },
+        { 42, { 0x2cb511e2, 0x6bdfcc05, 0x7cae76e4, 0x62cc5fd1, 0x94fe3ec9, 0xbcb20e66, 0x747031c8, 0xb19a5adb, 0x580d0b9a, 0x424798f9, 0x698843a3, 0x6f74552b } },
+};
+
+template<class T>
+static void performTestXoodooKnownAnswer(unsigned int rounds)
+{
+    T implementation(384, rounds);
+    UINT32 lanes[12];
+    unsigned int i;
+
+    memset(lanes, 0, sizeof(lanes));
+    for (i = 0; i < 1000; ++i)
+        implementation((unsigned char *)lanes);
+
+    for (i = 0; i < sizeof(knownAnswers) / sizeof(knownAnswers[0]); ++i)
+        if (knownAnswers[i].rounds == rounds)
+            assert(memcmp(knownAnswers[i].lanes, lanes, sizeof(lanes)) == 0);
+}
+
+/* The traced permutations must record the same rounds and end in the same state as the untraced one */
+static void performTestXoodooTrace(void)
+{
+    Xoodoo f(384, 12);
+    XoodooFixed<12> fixed(384);
+    unsigned char expected[stateByteSize], state[stateByteSize], stateFixed[stateByteSize];
+    unsigned char trace[12 * stateByteSize], traceFixed[12 * stateByteSize];
+
+    randomize(expected, stateByteSize);
+    memcpy(state, expected, stateByteSize);
+    memcpy(stateFixed, expected, stateByteSize);
+    f(expected);
+    f(state, XoodooRoundRecorder(trace));
+    fixed(stateFixed, XoodooRoundRecorder(traceFixed));
+    assert(memcmp(expected, state, stateByteSize) == 0);
+    assert(memcmp(expected, stateFixed, stateByteSize) == 0);
+    assert(memcmp(trace, traceFixed, sizeof(trace)) == 0);
+    assert(memcmp(trace + 11 * stateByteSize, expected, stateByteSize) == 0);
+}
+
+/* Fills the states with random values and returns in expected their image through the generic implementation */
+static void prepareStates(unsigned char (*states)[stateByteSize], unsigned char (*expected)[stateByteSize], unsigned int count, unsigned int rounds)
+{
+    XoodooBackend backend = getXoodooBackend();
+    Xoodoo reference(384, rounds);
+    unsigned int k;
+
+    setXoodooBackend(BACKEND_GENERIC);
+    for (k = 0; k < count; ++k)
+    {
+        randomize(states[k], stateByteSize);
+        memcpy(expected[k], states[k], stateByteSize);
+        reference(expected[k]);
+    }
+    setXoodooBackend(backend);
+}
+
+template<class T>
+static void performTestXoodooImplementation(unsigned int rounds)
+{
+    T implementation(384, rounds);
+    unsigned char expected[numberOfStates][stateByteSize];
+    unsigned char states[numberOfStates][stateByteSize];
+    unsigned int k;
+
+    prepareStates(states, expected, numberOfStates, rounds);
+    for (k = 0; k < numberOfStates; ++k)
+    {
+        implementation(states[k]);
+    }
+    assert(memcmp(expected, states, sizeof(states)) == 0);
+}
+
+template<unsigned int N>
+static void performTestXoodooTimes(unsigned int rounds)
+{
+    XoodooTimes<N> implementation(384, rounds);
+    unsigned char expected[numberOfStates][stateByteSize];
+    unsigned char states[numberOfStates][stateByteSize];
+    unsigned char *pointers[N];
+    unsigned int i, k;
+
+    prepareStates(states, expected, numberOfStates, rounds);
+    for (i = 0; i + N <= numberOfStates; i += N)
+    {
+        for (k = 0; k < N; ++k)
+        {
+            pointers[k] = states[i + k];
+        }
+        implementation(pointers);
+    }
+    assert(memcmp(expected, states, i * stateByteSize) == 0);
+}
+
+static void performTestTransformAll(unsigned int rounds)
+{
+    Xoodoo implementation(384, rounds);
+    unsigned char expected[40][stateByteSize];
+    unsigned char states[40][stateByteSize];
+    unsigned char *pointers[40];
+    unsigned int count, k;
+
+    for (count = 0; count <= 40; ++count)
+    {
+        prepareStates(states, expected, count, rounds);
+        for (k = 0; k < count; ++k)
+        {
+            pointers[k] = states[k];
+        }
+        transformAll(implementation, pointers, count);
+        assert(memcmp(expected, states, count * stateByteSize) == 0);
+    }
+}
+
+void testXoodooImplementations(void)
+{
+    static const unsigned int rounds[] = { 1, 6, 12, 14, 42 };
+    XoodooBackend backend = getXoodooBackend();
+    int b;
+    unsigned int i;
+
+    #if !defined(EMBEDDED)
+    srand((unsigned int)time(0));
+    #endif
+
+    for (b = BACKEND_GENERIC; b <= BACKEND_AVX512; ++b)
+    {
+        if (!isXoodooBackendSupported((XoodooBackend)b))
+            continue;
+        setXoodooBackend((XoodooBackend)b);
+
+        for (i = 0; i < sizeof(rounds) / sizeof(rounds[0]); ++i)
+        {
+            performTestXoodooKnownAnswer<Xoodoo>(rounds[i]);
+            if (XoodooSSE2::isAvailable())
+                performTestXoodooImplementation<XoodooSSE2>(rounds[i]);
+            performTestXoodooImplementation<Xoodoo>(rounds[i]);
+            performTestXoodooTimes<4>(rounds[i]);
+            performTestXoodooTimes<8>(rounds[i]);
+            performTestXoodooTimes<16>(rounds[i]);
+            performTestTransformAll(rounds[i]);
+        }
+
+        performTestXoodooTrace();
+        performTestXoodooKnownAnswer<XoodooFixed<6> >(6);
+        performTestXoodooKnownAnswer<XoodooFixed<12> >(12);
+
+        #ifdef VERBOSE
+        printf("Xoodoo backend %s matches the generic implementation\n", getXoodooBackendName((XoodooBackend)b));
+        #endif
+    }
+
+    setXoodooBackend(backend);
+}
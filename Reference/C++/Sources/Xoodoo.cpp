@@ -15,6 +15,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include <vector>
 
 #include "Xoodoo.h"
+#include "Xoodoo-dispatch.h"
 
 static const int RowSize = 4;
 static const int ColSize = 3;
@@ -50,13 +51,13 @@ Lane cyclicShiftLane(const Lane &a, int dz)
 	}
 }
 
-XoodooPlane::XoodooPlane() : lanes(RowSize)
+XoodooPlane::XoodooPlane() : lanes()
 {
 }
 
 XoodooPlane::XoodooPlane(const Lane *state)
 {
-	lanes.assign(state, state + RowSize);
+	std::copy(state, state + RowSize, lanes.begin());
 }
 
 const Lane &XoodooPlane::operator[](unsigned int i) const
@@ -124,7 +125,7 @@ XoodooPlane operator~(const XoodooPlane &A)
 	return p;
 }
 
-XoodooState::XoodooState() : planes(ColSize)
+XoodooState::XoodooState() : planes()
 {
 }
 
@@ -134,10 +135,15 @@ XoodooState::XoodooState(const UINT8 *state)
 
 	for (unsigned int i = 0; i < ColSize; i++)
 	{
-		planes.push_back(XoodooPlane(l + i * RowSize));
+		planes[i] = XoodooPlane(l + i * RowSize);
 	}
 }
 
+const XoodooPlane &XoodooState::operator[](unsigned int y) const
+{
+	return planes[y];
+}
+
 XoodooPlane &XoodooState::operator[](unsigned int y)
 {
 	return planes[y];
@@ -171,26 +177,6 @@ void XoodooState::dump(std::ostream &os) const
 	os.flags(f);
 }
 
-void Xoodoo::calculateRoundConstants()
-{
-	Lane s = 1;
-	Lane p = 1;
-
-	for (unsigned int i = 0; i < 6; i++)
-	{
-		rc_s.push_back(s);
-		s = (s * 5) % 7;
-	}
-
-	for (unsigned int i = 0; i < 7; i++)
-	{
-		rc_p.push_back(p);
-		p = p ^ (p << 2);
-		if ((p & 16) != 0) p ^= 22;
-		if ((p &  8) != 0) p ^= 11;
-	}
-}
-
 void Xoodoo::stepTheta(XoodooState &A) const
 {
 	XoodooPlane P = A[0] ^ A[1] ^ A[2];
@@ -210,8 +196,7 @@ void Xoodoo::stepRhoWest(XoodooState &A) const
 
 void Xoodoo::stepIota(XoodooState &A, int i) const
 {
-	Lane rc = (rc_p[-i % 7] ^ 8) << rc_s[-i % 6];
-	A[0][0] = A[0][0] ^ rc;
+	A[0][0] = A[0][0] ^ rc[i + rounds - 1];
 }
 
 void Xoodoo::stepChi(XoodooState &A) const
@@ -247,46 +232,50 @@ void Xoodoo::permute(XoodooState &A) const
 	for (int i = 1 - rounds; i <= 0; i++)
 	{
 		round(A, i);
-
-		if (logType == LOG_ROUND)
-		{
-			std::ios::fmtflags f(log->flags());
-			*log << "(Round " << std::setfill('0') << std::setw(2) << (i + rounds) << ") ";
-			log->flags(f);
-			A.dump(*log);
-		}
-	}
-
-	if (logType == LOG_FINAL)
-	{
-		A.dump(*log);
 	}
 }
 
 Xoodoo::Xoodoo(unsigned int width, unsigned int vrounds)
-	: rounds(vrounds), logType(LOG_NONE), log(NULL)
+	: rounds(vrounds)
 {
 	if (width != 384) throw Exception("Unsupported width");
 	if (rounds > 42) throw Exception("Unsupported number of rounds");
 
-	calculateRoundConstants();
+	for (unsigned int i = 0; i < rounds; i++)
+	{
+		rc[i] = roundConstant(static_cast<int>(i + 1) - static_cast<int>(rounds));
+	}
 }
 
 void Xoodoo::operator()(UINT8 *state) const
 {
+	XoodooKernel kernel = getXoodooKernel();
+
+	if (kernel != NULL)
+	{
+		kernel(state, rc.data(), rounds);
+		return;
+	}
+
+	switch (rounds)
+	{
+		case 6:  XoodooFixed<6>::permute(state);  return;
+		case 12: XoodooFixed<12>::permute(state); return;
+		default: break;
+	}
+
 	XoodooState A(state);
 	permute(A);
 	A.write(state);
 }
 
-void Xoodoo::unsetLog()
+Lane Xoodoo::roundConstant(int i) const
 {
-	logType = LOG_NONE;
-	log = NULL;
+	return xoodooRoundConstant(i);
 }
 
-void Xoodoo::setLog(XoodooLog type, std::ostream &os)
+unsigned int Xoodoo::getRounds() const
 {
-	logType = type;
-	log = &os;
+	return rounds;
 }
+
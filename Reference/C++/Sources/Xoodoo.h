@@ -13,7 +13,10 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define _XOODOO_H_
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 #include "transformations.h"
@@ -26,7 +29,7 @@ Lane cyclicShiftLane(const Lane &a, int dz);
 class XoodooPlane
 {
 	private:
-		std::vector<Lane> lanes;
+		std::array<Lane, 4> lanes;
 
 	public:
 		XoodooPlane();
@@ -44,33 +47,75 @@ XoodooPlane operator~(const XoodooPlane &A);
 class XoodooState
 {
 	private:
-		std::vector<XoodooPlane> planes;
+		std::array<XoodooPlane, 3> planes;
 
 	public:
 		XoodooState();
 		XoodooState(const UINT8 *state);
+		const XoodooPlane &operator[](unsigned int y) const;
 		XoodooPlane &operator[](unsigned int y);
 		void write(UINT8 *state) const;
 		void dump(std::ostream &os) const;
 };
 
-enum XoodooLog
+/**
+ * Round constant of round i, numbered from 1 - rounds to 0 as in Xoodoo::round()
+ *
+ * The constant is (p ^ 8) << s, with s and p the states of two small LFSRs
+ * after respectively (-i) % 6 and (-i) % 7 steps.
+ */
+constexpr Lane xoodooRoundConstant(int i)
 {
-	LOG_NONE,
-	LOG_ROUND,
-	LOG_FINAL,
+	Lane s = 1;
+	Lane p = 1;
+
+	for (int j = 0; j < (-i) % 6; j++)
+	{
+		s = (s * 5) % 7;
+	}
+
+	for (int j = 0; j < (-i) % 7; j++)
+	{
+		p = p ^ (p << 2);
+		if ((p & 16) != 0) p ^= 22;
+		if ((p &  8) != 0) p ^= 11;
+	}
+
+	return (p ^ 8) << s;
+}
+
+/**
+ * Tracer policies of the permutation: after round r (1 <= r <= rounds), the
+ * tracer is called with r and the 48-byte state.
+ */
+
+/**
+ * Tracer that does nothing, so that untraced permutations pay nothing for it
+ */
+struct XoodooNoTrace
+{
+	void operator()(unsigned int r, const UINT8 *state) const { (void)r; (void)state; }
 };
 
-class Xoodoo
+/**
+ * Tracer recording the state after each round in a caller-supplied buffer
+ * of at least 48 * rounds bytes, the state after round r at offset 48 * (r - 1)
+ */
+class XoodooRoundRecorder
 {
 	private:
-		std::vector<Lane> rc_s, rc_p;
-		unsigned int rounds;
+		UINT8 *buffer;
 
-		XoodooLog logType;
-		std::ostream *log;
+	public:
+		XoodooRoundRecorder(UINT8 *buffer) : buffer(buffer) {}
+		void operator()(unsigned int r, const UINT8 *state) const { std::memcpy(buffer + 48 * (r - 1), state, 48); }
+};
 
-		void calculateRoundConstants();
+class Xoodoo
+{
+	private:
+		std::array<Lane, 42> rc;                                       // Round constants in order of application
+		unsigned int rounds;
 
 		void stepTheta(XoodooState &A) const;
 		void stepRhoWest(XoodooState &A) const;
@@ -84,9 +129,125 @@ class Xoodoo
 	public:
 		Xoodoo(unsigned int width, unsigned int vrounds);
 		void operator()(UINT8 *state) const;
+		Lane roundConstant(int i) const;
+		unsigned int getRounds() const;
+
+		/**
+		 * Applies the permutation like operator(), calling @a tracer after each round
+		 */
+		template<class Tracer>
+		void operator()(UINT8 *state, const Tracer &tracer) const
+		{
+			XoodooState A(state);
+
+			for (int i = 1 - static_cast<int>(rounds); i <= 0; i++)
+			{
+				round(A, i);
+				A.write(state);
+				tracer(i + rounds, state);
+			}
+		}
+};
+
+void transformAll(const Xoodoo &f, UINT8 *const *states, unsigned int count);
+
+/**
+ * Class implementing Xoodoo with a number of rounds fixed at compile time
+ *
+ * The round loop is fully unrolled and the round constants are immediate
+ * values, so the permutation compiles to straight-line code.
+ */
+template<unsigned int Rounds>
+class XoodooFixed
+{
+	static_assert(Rounds <= 42, "Unsupported number of rounds");
+
+	private:
+		static Lane rol(Lane a, int dz)
+		{
+			return (a << dz) | (a >> (32 - dz));
+		}
+
+		template<int i>
+		static void round(Lane *a)
+		{
+			constexpr Lane rc = xoodooRoundConstant(i);
+			Lane p[4], e[4], b[4];
+
+			/* Theta */
+			for (int x = 0; x < 4; x++) p[x] = a[x] ^ a[4 + x] ^ a[8 + x];
+			for (int x = 0; x < 4; x++) e[x] = rol(p[(x + 3) % 4], 5) ^ rol(p[(x + 3) % 4], 14);
+			for (int x = 0; x < 12; x++) a[x] ^= e[x % 4];
+
+			/* Rho-west */
+			b[0] = a[7]; a[7] = a[6]; a[6] = a[5]; a[5] = a[4]; a[4] = b[0];
+			for (int x = 0; x < 4; x++) a[8 + x] = rol(a[8 + x], 11);
+
+			/* Iota, applied to the whole plane so that the step stays vectorizable */
+			const Lane iota[4] = { rc, 0, 0, 0 };
+			for (int x = 0; x < 4; x++) a[x] ^= iota[x];
+
+			/* Chi */
+			for (int x = 0; x < 4; x++)
+			{
+				b[0] = ~a[4 + x] & a[8 + x];
+				b[1] = ~a[8 + x] & a[x];
+				b[2] = ~a[x] & a[4 + x];
+				a[x] ^= b[0];
+				a[4 + x] ^= b[1];
+				a[8 + x] ^= b[2];
+			}
+
+			/* Rho-east */
+			for (int x = 0; x < 4; x++) a[4 + x] = rol(a[4 + x], 1);
+			for (int x = 0; x < 4; x++) b[x] = rol(a[8 + (x + 2) % 4], 8);
+			for (int x = 0; x < 4; x++) a[8 + x] = b[x];
+		}
+
+		template<std::size_t... I, class Tracer>
+		static void rounds(Lane *a, std::index_sequence<I...>, const Tracer &tracer)
+		{
+			int unrolled[] = { 0, (round<static_cast<int>(I) + 1 - static_cast<int>(Rounds)>(a), tracer(I + 1, reinterpret_cast<const UINT8 *>(a)), 0)... };
+			(void)unrolled;
+		}
 
-		void unsetLog();
-		void setLog(XoodooLog type, std::ostream &os);
+	public:
+		XoodooFixed(unsigned int width)
+		{
+			if (width != 384) throw Exception("Unsupported width");
+		}
+
+		XoodooFixed(unsigned int width, unsigned int vrounds)
+		{
+			if (width != 384) throw Exception("Unsupported width");
+			if (vrounds != Rounds) throw Exception("Unsupported number of rounds");
+		}
+
+		template<class Tracer>
+		static void permute(UINT8 *state, const Tracer &tracer)
+		{
+			Lane a[12];
+
+			std::memcpy(a, state, sizeof(a));
+			rounds(a, std::make_index_sequence<Rounds>(), tracer);
+			std::memcpy(state, a, sizeof(a));
+		}
+
+		static void permute(UINT8 *state)
+		{
+			permute(state, XoodooNoTrace());
+		}
+
+		void operator()(UINT8 *state) const
+		{
+			permute(state);
+		}
+
+		template<class Tracer>
+		void operator()(UINT8 *state, const Tracer &tracer) const
+		{
+			permute(state, tracer);
+		}
 };
 
 #endif
@@ -0,0 +1,168 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "Xoodoo-dispatch.h"
+#include "Xoodootimes.h"
+
+static XoodooTimesKernel selectKernel(unsigned int N, XoodooBackend backend)
+{
+	if (N == 4 && backend >= BACKEND_SSE2) return getXoodooTimes4KernelSSE2();
+	if (N == 8 && backend >= BACKEND_AVX2) return getXoodooTimes8KernelAVX2();
+	if (N == 16 && backend >= BACKEND_AVX512) return getXoodooTimes16KernelAVX512();
+	return NULL;
+}
+
+template<unsigned int N>
+XoodooTimes<N>::XoodooTimes(unsigned int width, unsigned int vrounds, XoodooBackend backend)
+	: f(width, vrounds), rc(), rounds(vrounds), kernel(selectKernel(N, backend))
+{
+	for (unsigned int i = 0; i < rounds; i++)
+	{
+		rc[i] = f.roundConstant(static_cast<int>(i + 1) - static_cast<int>(rounds));
+	}
+}
+
+template<unsigned int N>
+void XoodooTimes<N>::permuteAll(UINT32 *lanes) const
+{
+	if (kernel != NULL)
+	{
+		kernel(lanes, rc.data(), rounds);
+		return;
+	}
+
+	for (unsigned int k = 0; k < N; k++)
+	{
+		UINT32 state[12];
+
+		for (unsigned int i = 0; i < 12; i++) state[i] = lanes[i * N + k];
+		f(reinterpret_cast<UINT8 *>(state));
+		for (unsigned int i = 0; i < 12; i++) lanes[i * N + k] = state[i];
+	}
+}
+
+template<unsigned int N>
+void XoodooTimes<N>::operator()(UINT8 *const *states) const
+{
+	UINT32 lanes[12 * N];
+
+	interleave(lanes, states);
+	permuteAll(lanes);
+	deinterleave(states, lanes);
+}
+
+template<unsigned int N>
+bool XoodooTimes<N>::isParallel() const
+{
+	return kernel != NULL;
+}
+
+template<unsigned int N>
+void XoodooTimes<N>::interleave(UINT32 *lanes, const UINT8 *const *states)
+{
+	for (unsigned int k = 0; k < N; k++)
+	{
+		for (unsigned int i = 0; i < 12; i++)
+		{
+			std::memcpy(&lanes[i * N + k], states[k] + 4 * i, 4);
+		}
+	}
+}
+
+template<unsigned int N>
+void XoodooTimes<N>::deinterleave(UINT8 *const *states, const UINT32 *lanes)
+{
+	for (unsigned int k = 0; k < N; k++)
+	{
+		for (unsigned int i = 0; i < 12; i++)
+		{
+			std::memcpy(states[k] + 4 * i, &lanes[i * N + k], 4);
+		}
+	}
+}
+
+template class XoodooTimes<4>;
+template class XoodooTimes<8>;
+template class XoodooTimes<16>;
+
+template<unsigned int N>
+static unsigned int applyTimes(const XoodooTimes<N> &f, UINT8 *const *states, unsigned int count)
+{
+	unsigned int i = 0;
+
+	if (f.isParallel())
+	{
+		for (; i + N <= count; i += N)
+		{
+			f(states + i);
+		}
+	}
+
+	return i;
+}
+
+/* The parallel instances used by transformAll() for a number of rounds and a backend */
+struct XoodooTimesSet
+{
+	XoodooTimes<16> f16;
+	XoodooTimes<8>  f8;
+	XoodooTimes<4>  f4;
+
+	XoodooTimesSet(unsigned int rounds, XoodooBackend backend)
+		: f16(384, rounds, backend), f8(384, rounds, backend), f4(384, rounds, backend) {}
+};
+
+/* Returns the set for the active backend, building it on first use and then keeping it */
+static const XoodooTimesSet &timesSet(unsigned int rounds)
+{
+	static std::atomic<const XoodooTimesSet *>  sets[BACKEND_AVX512 + 1][43];
+	static std::unique_ptr<XoodooTimesSet>      owned[BACKEND_AVX512 + 1][43];
+	static std::mutex                           lock;
+
+	XoodooBackend backend = getXoodooBackend();
+	std::atomic<const XoodooTimesSet *> &slot = sets[backend][rounds];
+	const XoodooTimesSet *set = slot.load(std::memory_order_acquire);
+
+	if (set == NULL)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (!owned[backend][rounds]) owned[backend][rounds].reset(new XoodooTimesSet(rounds, backend));
+		set = owned[backend][rounds].get();
+		slot.store(set, std::memory_order_release);
+	}
+
+	return *set;
+}
+
+void transformAll(const Xoodoo &f, UINT8 *const *states, unsigned int count)
+{
+	unsigned int i = 0;
+
+	if (count >= 4)
+	{
+		const XoodooTimesSet &times = timesSet(f.getRounds());
+
+		i += applyTimes(times.f16, states + i, count - i);
+		i += applyTimes(times.f8, states + i, count - i);
+		i += applyTimes(times.f4, states + i, count - i);
+	}
+
+	for (; i < count; i++)
+	{
+		f(states[i]);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _XOODOOTIMES_H_
+#define _XOODOOTIMES_H_
+
+#include <array>
+
+#include "types.h"
+#include "Xoodoo.h"
+#include "Xoodoo-dispatch.h"
+
+/**
+ * Xoodoo on N lane-interleaved states, with the round constants given in order of application
+ */
+typedef void (*XoodooTimesKernel)(UINT32 *lanes, const UINT32 *rc, unsigned int rounds);
+
+XoodooTimesKernel getXoodooTimes4KernelSSE2();                      // NULL if not compiled in
+XoodooTimesKernel getXoodooTimes8KernelAVX2();                      // Idem
+XoodooTimesKernel getXoodooTimes16KernelAVX512();                   // Idem
+
+/**
+ * Class implementing N parallel instances of Xoodoo
+ *
+ * permuteAll() works on a lane-interleaved layout: lane i (0 <= i < 12, in the
+ * order of the serialized state) of instance k is stored at lanes[i * N + k].
+ */
+template<unsigned int N>
+class XoodooTimes
+{
+	private:
+		Xoodoo                  f;
+		std::array<UINT32, 42>  rc;
+		unsigned int            rounds;
+		XoodooTimesKernel       kernel;
+
+	public:
+		XoodooTimes(unsigned int width, unsigned int vrounds, XoodooBackend backend = getXoodooBackend());  // Kernel of backend, if any
+		void permuteAll(UINT32 *lanes) const;
+		void operator()(UINT8 *const *states) const;
+		bool isParallel() const;
+
+		static void interleave(UINT32 *lanes, const UINT8 *const *states);
+		static void deinterleave(UINT8 *const *states, const UINT32 *lanes);
+};
+
+#endif
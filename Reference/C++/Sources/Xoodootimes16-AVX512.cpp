@@ -0,0 +1,53 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "Xoodootimes.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace
+{
+	struct Ops
+	{
+		typedef __m512i V;
+		static const unsigned int N = 16;
+
+		static V load(const UINT32 *p) { return _mm512_loadu_si512(reinterpret_cast<const __m512i *>(p)); }
+		static void store(UINT32 *p, V a) { _mm512_storeu_si512(reinterpret_cast<__m512i *>(p), a); }
+		static V XOR(V a, V b) { return _mm512_xor_si512(a, b); }
+		static V ANDNOT(V a, V b) { return _mm512_andnot_si512(a, b); }
+		static V set1(UINT32 c) { return _mm512_set1_epi32(static_cast<int>(c)); }
+		template<int n> static V rol(V a) { return _mm512_rol_epi32(a, n); }
+	};
+
+	#include "Xoodootimes.inc"
+}
+
+static void permuteAll(UINT32 *lanes, const UINT32 *rc, unsigned int rounds)
+{
+	XoodooTimes_permuteAll<Ops>(lanes, rc, rounds);
+}
+
+XoodooTimesKernel getXoodooTimes16KernelAVX512()
+{
+	return permuteAll;
+}
+
+#else
+
+XoodooTimesKernel getXoodooTimes16KernelAVX512()
+{
+	return NULL;
+}
+
+#endif
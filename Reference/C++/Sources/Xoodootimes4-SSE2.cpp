@@ -0,0 +1,53 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "Xoodootimes.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+
+#include <emmintrin.h>
+
+namespace
+{
+	struct Ops
+	{
+		typedef __m128i V;
+		static const unsigned int N = 4;
+
+		static V load(const UINT32 *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+		static void store(UINT32 *p, V a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a); }
+		static V XOR(V a, V b) { return _mm_xor_si128(a, b); }
+		static V ANDNOT(V a, V b) { return _mm_andnot_si128(a, b); }
+		static V set1(UINT32 c) { return _mm_set1_epi32(static_cast<int>(c)); }
+		template<int n> static V rol(V a) { return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n)); }
+	};
+
+	#include "Xoodootimes.inc"
+}
+
+static void permuteAll(UINT32 *lanes, const UINT32 *rc, unsigned int rounds)
+{
+	XoodooTimes_permuteAll<Ops>(lanes, rc, rounds);
+}
+
+XoodooTimesKernel getXoodooTimes4KernelSSE2()
+{
+	return permuteAll;
+}
+
+#else
+
+XoodooTimesKernel getXoodooTimes4KernelSSE2()
+{
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "Xoodootimes.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+	struct Ops
+	{
+		typedef __m256i V;
+		static const unsigned int N = 8;
+
+		static V load(const UINT32 *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+		static void store(UINT32 *p, V a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a); }
+		static V XOR(V a, V b) { return _mm256_xor_si256(a, b); }
+		static V ANDNOT(V a, V b) { return _mm256_andnot_si256(a, b); }
+		static V set1(UINT32 c) { return _mm256_set1_epi32(static_cast<int>(c)); }
+		template<int n> static V rol(V a) { return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n)); }
+	};
+
+	#include "Xoodootimes.inc"
+}
+
+static void permuteAll(UINT32 *lanes, const UINT32 *rc, unsigned int rounds)
+{
+	XoodooTimes_permuteAll<Ops>(lanes, rc, rounds);
+}
+
+XoodooTimesKernel getXoodooTimes8KernelAVX2()
+{
+	return permuteAll;
+}
+
+#else
+
+XoodooTimesKernel getXoodooTimes8KernelAVX2()
+{
+	return NULL;
+}
+
+#endif
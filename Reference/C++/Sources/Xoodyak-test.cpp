@@ -9,6 +9,7 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include "Xoodoo-dispatch.h"
 #include "Xoodyak.h"
 
 #if !defined(EMBEDDED)
@@ -84,10 +85,195 @@ static void assert(int condition, const char * synopsis)
 
 #endif
 
+#ifndef Xoodoo_excluded
+
+/* EncryptUpdate()/DecryptUpdate() in chunks against one-shot Encrypt()/Decrypt() */
+static void performTestXoodyakStreaming( void )
+{
+    const size_t lengths[] = { 0, 1, 23, 24, 25, 48, 1000 };
+    const size_t chunks[] = { 1, 5, 24, 100, 2000 };
+    BitString K(std::string("0123456789abcdef")), empty;
+    uint8_t P[1000];
+
+    generateSimpleRawMaterial(P, sizeof(P), 0x21, 3);
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); j++) {
+            size_t n = lengths[i];
+            Xoodyak oneShot(K, empty, empty), encrypt(K, empty, empty), decrypt(K, empty, empty);
+            uint8_t C[1000], Q[1000];
+
+            BitString expected = oneShot.Encrypt(BitString(P, 8 * n));
+            BitString tag = oneShot.Squeeze(16);
+            for (size_t done = 0; done < n; done += chunks[j]) {
+                size_t len = (n - done < chunks[j]) ? n - done : chunks[j];
+                encrypt.EncryptUpdate(P + done, C + done, len);
+            }
+            assert(BitString(C, 8 * n) == expected, "Chunked encryption differs from Encrypt()");
+            assert(encrypt.Finalize(16) == tag, "Chunked encryption tag differs");
+
+            memcpy(Q, C, n);
+            decrypt.DecryptUpdate(Q, Q, n / 2);                      /* in place */
+            decrypt.DecryptUpdate(Q + n / 2, Q + n / 2, n - n / 2);
+            assert(memcmp(Q, P, n) == 0, "Chunked decryption differs from the plaintext");
+            assert(decrypt.Finalize(16) == tag, "Chunked decryption tag differs");
+        }
+}
+
+/* XoodyakHashBatch on messages of unequal lengths against one Xoodyak per message, with each backend */
+static void performTestXoodyakHashBatch( void )
+{
+    const UINT64 outputs[] = { 0, 1, 16, 32, 50 };
+    XoodooBackend backend = getXoodooBackend();
+    std::vector<BitString> M;
+    BitString empty;
+    uint8_t data[300];
+
+    for (unsigned int i = 0; i < 41; i++) {
+        unsigned int length = (i * 37) % 300;
+        generateSimpleRawMaterial(data, length, (uint8_t)i, 5);
+        M.push_back(BitString(data, 8 * length));
+    }
+
+    for (int b = BACKEND_GENERIC; b <= BACKEND_AVX512; ++b) {
+        if (!isXoodooBackendSupported((XoodooBackend)b))
+            continue;
+        setXoodooBackend((XoodooBackend)b);
+
+        for (size_t j = 0; j < sizeof(outputs) / sizeof(outputs[0]); j++) {
+            std::vector<BitString> H = XoodyakHashBatch()(M, outputs[j]);
+            assert(H.size() == M.size(), "XoodyakHashBatch must return one hash per message");
+            for (size_t i = 0; i < M.size(); i++) {
+                Xoodyak h(empty, empty, empty);
+                h.Absorb(M[i]);
+                assert(H[i] == h.Squeeze(outputs[j]), "XoodyakHashBatch differs from Xoodyak");
+            }
+        }
+    }
+    assert(XoodyakHashBatch()(std::vector<BitString>(), 16).empty(), "An empty batch has no hash");
+    setXoodooBackend(backend);
+}
+
+/* XoodyakAEADBatch on packets of unequal shapes against one Xoodyak per packet, with each backend */
+static void performTestXoodyakAEADBatch( void )
+{
+    XoodooBackend backend = getXoodooBackend();
+    std::vector<XoodyakPacket> packets;
+    uint8_t data[200];
+
+    for (unsigned int i = 0; i < 37; i++) {
+        XoodyakPacket p;
+        generateSimpleRawMaterial(data, sizeof(data), (uint8_t)i, 3);
+        p.K = BitString(data, 8 * (16 + i % 17));
+        p.id = BitString(data + 40, 8 * (i % 3) * 4);
+        p.counter = BitString(data + 60, 8 * (i % 4));
+        p.AD = BitString(data + 70, 8 * ((i * 13) % 100));
+        p.P = BitString(data + 100, 8 * ((i * 29) % 100));
+        packets.push_back(p);
+    }
+
+    for (int b = BACKEND_GENERIC; b <= BACKEND_AVX512; ++b) {
+        if (!isXoodooBackendSupported((XoodooBackend)b))
+            continue;
+        setXoodooBackend((XoodooBackend)b);
+
+        std::vector<std::pair<BitString, BitString> > sealed = XoodyakAEADBatch().encrypt(packets, 16);
+        std::vector<XoodyakPacket> received = packets;
+        for (size_t i = 0; i < packets.size(); i++) {
+            const XoodyakPacket &p = packets[i];
+            Xoodyak x(p.K, p.id, p.counter);
+            x.Absorb(p.AD);
+            assert(sealed[i].first == x.Encrypt(p.P), "XoodyakAEADBatch ciphertext differs from Xoodyak");
+            assert(sealed[i].second == x.Squeeze(16), "XoodyakAEADBatch tag differs from Xoodyak");
+            received[i].P = sealed[i].first;
+            received[i].T = sealed[i].second;
+        }
+
+        /* Every third packet has its ciphertext or its tag altered, or its tag cut */
+        std::vector<XoodyakPacket> tampered = received;
+        for (size_t i = 0; i < packets.size(); i += 3) {
+            std::string altered = ((i % 2 == 0) && tampered[i].P.size() != 0) ? tampered[i].P.str() : tampered[i].T.str();
+            altered[(i * 7) % altered.size()] ^= 0x10;
+            if ((i % 2 == 0) && tampered[i].P.size() != 0) tampered[i].P = BitString(altered);
+            else if (i % 9 == 3) tampered[i].T = BitString(altered.substr(0, 15));
+            else tampered[i].T = BitString(altered);
+        }
+
+        std::vector<std::pair<bool, BitString> > opened = XoodyakAEADBatch().decrypt(received, 16);
+        std::vector<std::pair<bool, BitString> > rejected = XoodyakAEADBatch().decrypt(tampered, 16);
+        for (size_t i = 0; i < packets.size(); i++) {
+            assert(opened[i].first && opened[i].second == packets[i].P, "XoodyakAEADBatch decryption differs from the plaintext");
+            assert(rejected[i].first == (i % 3 != 0), "XoodyakAEADBatch must reject exactly the altered packets");
+            assert(rejected[i].second == (rejected[i].first ? packets[i].P : BitString()), "XoodyakAEADBatch must not release unverified plaintext");
+        }
+    }
+    setXoodooBackend(backend);
+}
+
+static bool rejectsSnapshot(Xoodyak &x, const BitString &data)
+{
+    try {
+        x.restore(CyclistSnapshot::deserialize(data));
+    }
+    catch (Exception &) {
+        return true;
+    }
+    return false;
+}
+
+/* Snapshots restored in place, serialized and resumed in a new instance, also in the middle of a chunked encryption */
+static void performTestXoodyakSnapshot( void )
+{
+    BitString K(std::string("0123456789abcdef")), id(std::string("id")), counter(std::string("0123456789abcdef")), empty;
+    uint8_t P[100], C[100], D[100];
+
+    generateSimpleRawMaterial(P, sizeof(P), 0x42, 7);
+    Xoodyak x(K, id, counter);
+    CyclistSnapshot S = x.snapshot();
+    x.Absorb(BitString(P, 8 * 30));
+    BitString C1 = x.Encrypt(BitString(P, 8 * 70));
+    BitString T1 = x.Squeeze(16);
+    x.restore(S);
+    x.Absorb(BitString(P, 8 * 30));
+    assert(x.Encrypt(BitString(P, 8 * 70)) == C1, "Restoring a snapshot must replay the same ciphertext");
+    assert(x.Squeeze(16) == T1, "Restoring a snapshot must replay the same tag");
+
+    Xoodyak y(CyclistSnapshot::deserialize(S.serialize()));
+    y.Absorb(BitString(P, 8 * 30));
+    assert(y.Encrypt(BitString(P, 8 * 70)) == C1, "A deserialized snapshot must resume the instance");
+    assert(y.Squeeze(16) == T1, "A deserialized snapshot must resume the instance tag");
+
+    x.restore(S);
+    x.Absorb(BitString(P, 8 * 30));
+    x.EncryptUpdate(P, C, 31);
+    Xoodyak z(CyclistSnapshot::deserialize(x.snapshot().serialize()));
+    x.EncryptUpdate(P + 31, C + 31, 39);
+    z.EncryptUpdate(P + 31, D + 31, 39);
+    assert(BitString(C, 8 * 70) == C1 && memcmp(C + 31, D + 31, 39) == 0, "A snapshot must resume a chunked encryption");
+    assert(x.Finalize(16) == T1 && z.Finalize(16) == T1, "A snapshot must resume a chunked encryption tag");
+
+    Xoodyak h(empty, empty, empty);
+    BitString hashed = h.snapshot().serialize(), keyed = S.serialize();
+    std::string bad = keyed.str();
+    bad[0] ^= 1;
+    assert(rejectsSnapshot(x, BitString(bad)), "An unknown snapshot version must be rejected");
+    assert(rejectsSnapshot(x, BitString::substring(keyed, 0, keyed.size() - 8)), "A truncated snapshot must be rejected");
+    bad = hashed.str();
+    bad[1] = 1;
+    assert(rejectsSnapshot(h, BitString(bad)), "A keyed snapshot with the hash rates must be rejected");
+    assert(!rejectsSnapshot(h, keyed), "A keyed snapshot must restore into a hash instance");
+}
+
+#endif
+
 int testXoodyak( void )
 {
 #ifndef Xoodoo_excluded
 
+    performTestXoodyakStreaming();
+    performTestXoodyakHashBatch();
+    performTestXoodyakAEADBatch();
+    performTestXoodyakSnapshot();
+
     PRINTS("Xoodyak\n");
     Xoodyak_testHash("XoodyakHash.txt", (uint8_t*)"\x72\xbb\x07\xae\x9c\xae\x32\xb3\x0e\xa4\x73\x65\x67\x01\xf3\xd8\x25\xbd\x56\x82\x1b\xb6\xa4\x5d\x2c\xba\xbc\x50\x78\xab\x4c\x7a");
     Xoodyak_testKeyed("XoodyakKeyed.txt", (uint8_t*)"\xf9\x58\xff\x34\x0f\x78\xf0\x49\xc8\x05\x14\x8f\xee\x9a\x5f\xc4\x72\xe5\x83\xbc\x1e\x5d\x43\xd7\x71\x3b\xa8\x1f\xb4\x4a\x4b\xb6");
@@ -9,6 +9,12 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "Xoodootimes.h"
 #include "Xoodyak.h"
 
 /* Xoodyak instantiation parameters */
@@ -28,3 +34,330 @@ Xoodyak::Xoodyak(const BitString &K, const BitString &id, const BitString &count
 			  K, id, counter)
 {
 }
+
+Xoodyak::Xoodyak(const CyclistSnapshot &S)
+	: Cyclist(XoodyakParams::f, XoodyakParams::param_Rhash, XoodyakParams::param_Rkin, XoodyakParams::param_Rkout, XoodyakParams::param_lratchet,
+			  S)
+{
+}
+
+/* Batches */
+namespace
+{
+	/* One Cyclist call of a program */
+	struct CyclistCall
+	{
+		enum Kind { ABSORB, CRYPT, SQUEEZE } kind;
+		const UINT8 *  I;                                            // Absorbed or crypted bytes
+		UINT8 *        O;                                            // Crypted or squeezed bytes
+		size_t         len;
+		unsigned int   r;
+		UINT8          color;                                        // cD or cU of the first block
+		bool           decrypt;
+	};
+
+	/**
+	 * Cyclist calls on one message, run on instance k of lane-interleaved states
+	 *
+	 * run() follows Cyclist step by step up to the next Up(), whose permutation
+	 * is left to the caller, and resumes after it on the next call. Bytes are
+	 * mapped to lanes as in XoodooTimes::interleave().
+	 */
+	class CyclistProgram
+	{
+		public:
+			static const unsigned int MaxCalls = 5;
+
+		protected:
+			CyclistCall    calls[MaxCalls];
+			unsigned int   count;
+			bool           keyed;
+			unsigned int   call;                                     // Position: call, block in the call and whether its Up() is done
+			size_t         block;
+			bool           up;
+			CyclistPhase   phase;
+
+			void add(CyclistCall::Kind kind, const UINT8 *I, UINT8 *O, size_t len, unsigned int r, UINT8 color, bool decrypt)
+			{
+				CyclistCall c = { kind, I, O, len, r, color, decrypt };
+				calls[count++] = c;
+			}
+
+			template<unsigned int N>
+			static void xorColor(UINT32 *lanes, unsigned int k, UINT8 color)
+			{
+				UINT8 bytes[4] = { 0, 0, 0, color };
+				UINT32 w;
+
+				std::memcpy(&w, bytes, 4);
+				lanes[11 * N + k] ^= w;
+			}
+
+			/* s ^= X || 0x01 || 0^* || cD, X being already in the state if NULL */
+			template<unsigned int N>
+			void Down(UINT32 *lanes, unsigned int k, const UINT8 *X, size_t n, UINT8 cD)
+			{
+				size_t full = n / 4;
+				UINT8 bytes[4] = { 0 };
+				UINT32 w;
+
+				for (size_t i = 0; X != NULL && i < full; i++)
+				{
+					std::memcpy(&w, X + 4 * i, 4);
+					lanes[i * N + k] ^= w;
+				}
+				for (size_t j = 0; X != NULL && j < n % 4; j++) bytes[j] = X[4 * full + j];
+				bytes[n % 4] = 0x01;
+				std::memcpy(&w, bytes, 4);
+				lanes[full * N + k] ^= w;
+				if (cD != 0) xorColor<N>(lanes, k, keyed ? cD : (cD & 0x01));
+				phase = PHASE_DOWN;
+			}
+
+			/* The part of Up() before the permutation */
+			template<unsigned int N>
+			bool Up(UINT32 *lanes, unsigned int k, UINT8 cU)
+			{
+				if (keyed && cU != 0) xorColor<N>(lanes, k, cU);
+				phase = PHASE_UP;
+				up = true;
+				return true;
+			}
+
+			/* O = I ^ s on n bytes, or O = s if I is NULL; with decrypt, the state then takes I, otherwise O */
+			template<unsigned int N>
+			static void output(UINT32 *lanes, unsigned int k, const UINT8 *I, UINT8 *O, size_t n, bool decrypt)
+			{
+				size_t full = n / 4;
+
+				for (size_t i = 0; i < full; i++)                    // Whole lanes, with copies of constant size
+				{
+					UINT32 &w = lanes[i * N + k];
+					UINT32 x = 0, y;
+
+					if (I != NULL) std::memcpy(&x, I + 4 * i, 4);
+					y = x ^ w;
+					std::memcpy(O + 4 * i, &y, 4);
+					if (I != NULL) w = decrypt ? x : y;
+				}
+				if (n % 4 != 0)
+				{
+					UINT32 &w = lanes[full * N + k];
+					UINT8 s[4], x[4] = { 0 }, y[4];
+
+					std::memcpy(s, &w, 4);
+					for (size_t j = 0; j < n % 4; j++)
+					{
+						if (I != NULL) x[j] = I[4 * full + j];
+						y[j] = x[j] ^ s[j];
+						O[4 * full + j] = y[j];
+						if (I != NULL) s[j] = decrypt ? x[j] : y[j];
+					}
+					std::memcpy(&w, s, 4);
+				}
+			}
+
+		public:
+			BitString      scratch;                                  // Storage for a derived input, such as K || id || |id|
+
+			void reset(bool vkeyed)
+			{
+				count = 0;
+				keyed = vkeyed;
+				call = 0;
+				block = 0;
+				up = false;
+				phase = PHASE_UP;
+			}
+
+			void AbsorbAny(const UINT8 *X, size_t len, unsigned int r, UINT8 cD) { add(CyclistCall::ABSORB, X, NULL, len, r, cD, false); }
+			void Crypt(const UINT8 *I, UINT8 *O, size_t len, unsigned int r, bool decrypt) { add(CyclistCall::CRYPT, I, O, len, r, CONSTANT_CRYPT, decrypt); }
+			void SqueezeAny(UINT8 *Y, size_t len, unsigned int r, UINT8 cU) { add(CyclistCall::SQUEEZE, NULL, Y, len, r, cU, false); }
+
+			/* Runs up to the next permutation and returns true, or returns false once done */
+			template<unsigned int N>
+			bool run(UINT32 *lanes, unsigned int k)
+			{
+				while (call < count)
+				{
+					const CyclistCall &c = calls[call];
+					size_t blocks = std::max<size_t>(1, (c.len + c.r - 1) / c.r);
+
+					if (block == blocks)
+					{
+						call++;
+						block = 0;
+						up = false;
+						continue;
+					}
+
+					size_t at = block * c.r;
+					size_t n = std::min<size_t>(c.len - at, c.r);
+					UINT8 color = (block == 0) ? c.color : (UINT8)CONSTANT_ZERO;
+
+					switch (c.kind)
+					{
+						case CyclistCall::ABSORB:
+							if (phase != PHASE_UP) return Up<N>(lanes, k, CONSTANT_ZERO);
+							Down<N>(lanes, k, c.I + at, n, color);
+							break;
+						case CyclistCall::CRYPT:
+							if (!up) return Up<N>(lanes, k, color);
+							output<N>(lanes, k, c.I + at, c.O + at, n, c.decrypt);
+							Down<N>(lanes, k, NULL, n, CONSTANT_ZERO);
+							break;
+						case CyclistCall::SQUEEZE:
+							if (!up)
+							{
+								if (block > 0) Down<N>(lanes, k, NULL, 0, CONSTANT_ZERO);
+								return Up<N>(lanes, k, color);
+							}
+							output<N>(lanes, k, NULL, c.O + at, n, false);
+							break;
+					}
+					block++;
+					up = false;
+				}
+
+				return false;
+			}
+	};
+
+	typedef std::function<void(size_t, CyclistProgram &)> CyclistBuilder;
+
+	/*
+	 * Runs count programs on the N instances, permuted in lockstep. An instance
+	 * whose program is done takes the next one, the others being unaffected.
+	 */
+	template<unsigned int N>
+	void runAll(const XoodooTimes<N> &f, size_t count, const CyclistBuilder &build)
+	{
+		UINT32 lanes[12 * N];
+		CyclistProgram programs[N];
+		bool busy[N];
+		size_t next = 0;
+		unsigned int active = 0;
+
+		auto start = [&](unsigned int k)                              // Instance k takes programs up to one that needs a permutation
+		{
+			while (next < count)
+			{
+				for (unsigned int i = 0; i < 12; i++) lanes[i * N + k] = 0;
+				build(next++, programs[k]);
+				if (programs[k].template run<N>(lanes, k)) return true;
+			}
+			return false;
+		};
+
+		for (unsigned int k = 0; k < N; k++)
+		{
+			busy[k] = start(k);
+			if (busy[k]) active++;
+		}
+
+		while (active > 0)
+		{
+			f.permuteAll(lanes);                                     // Up() of every instance, idle ones included
+			for (unsigned int k = 0; k < N; k++)
+			{
+				if (!busy[k] || programs[k].template run<N>(lanes, k)) continue;
+				busy[k] = start(k);
+				if (!busy[k]) active--;
+			}
+		}
+	}
+
+	/* On the widest parallel Xoodoo available, or serially */
+	void runAll(size_t count, const CyclistBuilder &build)
+	{
+		const unsigned int rounds = XoodyakParams::f.rounds;
+		XoodooTimes<16> f16(384, rounds);
+		XoodooTimes<8>  f8(384, rounds);
+		XoodooTimes<4>  f4(384, rounds);
+
+		if (f16.isParallel())     runAll(f16, count, build);
+		else if (f8.isParallel()) runAll(f8, count, build);
+		else                      runAll(f4, count, build);
+	}
+
+	size_t bytes(const BitString &S, const char *what)
+	{
+		if (S.size() % 8 != 0) throw Exception(std::string(what) + " must be a whole number of bytes");
+		return (size_t)(S.size() / 8);
+	}
+}
+
+/* XoodyakHashBatch */
+std::vector<BitString> XoodyakHashBatch::operator()(const std::vector<BitString> &M, UINT64 l) const
+{
+	if (l > ~(UINT64)0 / 8) throw Exception("l must be less than 2^61 bytes");
+	for (size_t i = 0; i < M.size(); i++) bytes(M[i], "Messages");
+
+	std::vector<BitString> H(M.size(), BitString::zeroes(8 * l));
+
+	runAll(M.size(), [&](size_t i, CyclistProgram &p)
+	{
+		p.reset(false);
+		p.AbsorbAny(M[i].array(), bytes(M[i], "Messages"), XoodyakParams::param_Rhash, CONSTANT_ABSORB);
+		p.SqueezeAny(H[i].array(), (size_t)l, XoodyakParams::param_Rhash, CONSTANT_SQUEEZE);
+	});
+
+	return H;
+}
+
+/* XoodyakAEADBatch */
+std::vector<std::pair<BitString, BitString> > XoodyakAEADBatch::encrypt(const std::vector<XoodyakPacket> &packets, UINT64 t) const
+{
+	return crypt(packets, t, false);
+}
+
+std::vector<std::pair<bool, BitString> > XoodyakAEADBatch::decrypt(const std::vector<XoodyakPacket> &packets, UINT64 t) const
+{
+	std::vector<std::pair<BitString, BitString> > opened = crypt(packets, t, true);
+	std::vector<std::pair<bool, BitString> > out(packets.size());
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		out[i].first = equalsConstantTime(opened[i].second, packets[i].T);
+		if (out[i].first) out[i].second = std::move(opened[i].first);
+		else opened[i].first.wipe();
+	}
+
+	return out;
+}
+
+std::vector<std::pair<BitString, BitString> > XoodyakAEADBatch::crypt(const std::vector<XoodyakPacket> &packets, UINT64 t, bool decrypt) const
+{
+	if (t > ~(UINT64)0 / 8) throw Exception("t must be less than 2^61 bytes");
+
+	std::vector<std::pair<BitString, BitString> > out(packets.size());
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		const XoodyakPacket &P = packets[i];
+		if (P.K.size() == 0) throw Exception("Keys must not be empty");
+		if (P.K.size() + P.id.size() > 8 * XoodyakParams::param_Rkin - 1) throw Exception("|K || id| must be <= R_kin - 1 bytes");
+		bytes(P.K, "Keys");
+		bytes(P.id, "Identifiers");
+		bytes(P.counter, "Counters");
+		bytes(P.AD, "Associated data");
+		out[i].first = BitString::zeroes(8 * bytes(P.P, "Messages"));
+		out[i].second = BitString::zeroes(8 * t);
+	}
+
+	runAll(packets.size(), [&](size_t i, CyclistProgram &p)
+	{
+		const XoodyakPacket &P = packets[i];
+		unsigned int Rkin = XoodyakParams::param_Rkin;
+
+		p.reset(true);
+		p.scratch = P.K || P.id || BitString(8, (UINT8)(P.id.size() / 8));
+		p.AbsorbAny(p.scratch.array(), bytes(p.scratch, "Keys"), Rkin, CONSTANT_ABSORB_KEY);
+		if (P.counter.size() != 0) p.AbsorbAny(P.counter.array(), bytes(P.counter, "Counters"), 1, CONSTANT_ZERO);
+		p.AbsorbAny(P.AD.array(), bytes(P.AD, "Associated data"), Rkin, CONSTANT_ABSORB);
+		p.Crypt(P.P.array(), out[i].first.array(), bytes(P.P, "Messages"), XoodyakParams::param_Rkout, decrypt);
+		p.SqueezeAny(out[i].second.array(), (size_t)t, XoodyakParams::param_Rkout, CONSTANT_SQUEEZE);
+	});
+
+	return out;
+}
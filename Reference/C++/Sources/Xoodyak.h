@@ -14,6 +14,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 #include <iostream>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "bitstring.h"
 #include "Cyclist.h"
@@ -25,6 +27,53 @@ class Xoodyak : public Cyclist
 {
 	public:
 		Xoodyak(const BitString &K, const BitString &id, const BitString &counter);
+		Xoodyak(const CyclistSnapshot &S);                           // Resumes a snapshot() of another instance
+};
+
+/**
+ * Class hashing independent messages with Xoodyak, several at a time
+ *
+ * H[i] is the output of Xoodyak in hash mode after Absorb(M[i]) and Squeeze(l).
+ * The messages are spread over the instances of the widest parallel Xoodoo
+ * available, which are permuted in lockstep: each instance absorbs and squeezes
+ * its own message, and takes the next message of the list once it is done.
+ */
+class XoodyakHashBatch
+{
+	public:
+		std::vector<BitString> operator()(const std::vector<BitString> &M, UINT64 l) const;
+};
+
+/**
+ * Inputs of one message of XoodyakAEADBatch, all whole numbers of bytes
+ */
+class XoodyakPacket
+{
+	public:
+		BitString K, id, counter;                                    // Non-empty K
+		BitString AD;
+		BitString P;                                                 // Plaintext, or ciphertext when decrypting
+		BitString T;                                                 // Tag received, when decrypting
+};
+
+/**
+ * Class running Xoodyak authenticated encryption on independent messages, several at a time
+ *
+ * For each packet, encrypt() returns C and T from Xoodyak(K, id, counter),
+ * Absorb(AD), C = Encrypt(P) and T = Squeeze(t). decrypt() computes the tag
+ * of each packet with Decrypt() and compares it in constant time to the t
+ * bytes received in T: it returns true and the plaintext if they match, and
+ * false and an empty string otherwise, the plaintext being wiped. Instances
+ * run in lockstep as in XoodyakHashBatch.
+ */
+class XoodyakAEADBatch
+{
+	protected:
+		std::vector<std::pair<BitString, BitString> > crypt(const std::vector<XoodyakPacket> &packets, UINT64 t, bool decrypt) const;
+
+	public:
+		std::vector<std::pair<BitString, BitString> > encrypt(const std::vector<XoodyakPacket> &packets, UINT64 t) const;
+		std::vector<std::pair<bool, BitString> >      decrypt(const std::vector<XoodyakPacket> &packets, UINT64 t) const;
 };
 
 #endif
@@ -12,6 +12,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak.h"
 #include "Xoofff.h"
 #include "Xoofff-test.h"
+#include "threadpool.h"
 
 /* #define OUTPUT */
 /* #define VERBOSE */
@@ -290,8 +291,186 @@ void printXoofffTestVectors()
 }
 #endif
 
+/* Lengths are on 64 bits: an output whose end n + q does not fit is rejected before any work */
+static void performTestXoofffLengths(void)
+{
+    Xoofff xoofff;
+    BitString K = BitString::zeroes(128), M = BitString::zeroes(8);
+    bool rejected = false;
+
+    try {
+        xoofff(K, M, 16, ~(UINT64)0 - 8);
+    }
+    catch (Exception &) {
+        rejected = true;
+    }
+    assert(rejected);
+    assert(xoofff(K, M, 16, 8) == BitString::substring(xoofff(K, M, 24), 8, 16));
+}
+
+/*
+ * A message longer than 2^32 bits: shortening it within its last block changes only the term
+ * of that block, which is computed apart from its padding and the rolled key
+ */
+static void performTestXoofffLarge(void)
+{
+    Xoofff xoofff;
+    IterableTransformation<Xoodoo> p_c(XnP_width, 6);
+    XoodooCompressionRollingFunction roll_c;
+    const UINT64 size = ((UINT64)1 << 32) + 1000;
+    const UINT64 mu = size / XnP_width + 1;
+    const UINT64 shorter = size - 37;
+    const FarfalleState S0 = xoofff.start(BitString::ones(200));
+    FarfalleState S = S0, T = S0;
+
+    BitString M = BitString::zeroes(size);
+    M.overwrite(BitString::ones(296), size - 296);
+    xoofff.compress(S, M);
+    assert(S.I == mu + 1 && S.kI == roll_c(S0.kI, mu + 1));
+
+    BitString k = roll_c(S0.kI, mu - 1);
+    BitString last = BitString::substring(M, (mu - 1) * XnP_width, size % XnP_width) || BitString::pad10(XnP_width, size);
+    BitString lastShorter = BitString::substring(M, (mu - 1) * XnP_width, shorter % XnP_width) || BitString::pad10(XnP_width, shorter);
+    M.truncate(shorter);
+    xoofff.compress(T, M);
+    assert(T.I == S.I && T.kI == S.kI);
+    assert((S.x ^ T.x) == (p_c(last ^ k) ^ p_c(lastShorter ^ k)));
+}
+
+/* Expanding from offset q gives the bits q to q + n - 1 of the output from offset 0 */
+static void performTestXoofffSeek(void)
+{
+    Xoofff xoofff;
+    BitString K = BitString::ones(200), M = BitString::zeroes(100);
+    BitString Z = xoofff(K, M, 16 * XnP_width);
+    const UINT64 offsets[] = { 0, 1, 7, XnP_width - 1, XnP_width, XnP_width + 1, 5 * XnP_width + 77 };
+    const UINT64 lengths[] = { 0, 1, 8, XnP_width - 1, XnP_width, 700, 9 * XnP_width + 3 };
+
+    for (unsigned int i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+        for (unsigned int j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++)
+            assert(xoofff(K, M, lengths[j], offsets[i]) == BitString::substring(Z, offsets[i], lengths[j]));
+}
+
+/* Jumps of the linear compression roll against stepping, and iterators against roll(k, i) */
+static void performTestXoofffRolling(void)
+{
+    XoodooCompressionRollingFunction roll_c;
+    XoodooExpansionRollingFunction roll_e;
+    std::vector<UINT8> v(XnP_width / 8);
+    for (unsigned int i = 0; i < v.size(); i++) v[i] = (UINT8)(3 * i + 1);
+    const BitString k(v);
+    const UINT64 indexes[] = { 0, 1, 255, 256, 257, 1000, 4097, 123457 };
+
+    RollingIterator it(roll_c, k);
+    for (unsigned int j = 0; j < sizeof(indexes) / sizeof(indexes[0]); j++) {
+        while (it.index() < indexes[j]) ++it;
+        assert(roll_c(k, indexes[j]) == *it);
+    }
+    assert(roll_c(roll_c(k, 70000), 70001) == roll_c(k, 140001));
+
+    RollingIterator ie(roll_e, k, 1000);
+    for (unsigned int j = 0; j < 10; j++, ++ie) assert(roll_e(k, ie.index()) == *ie);
+}
+
+/* A prefix compressed once and forked, against compressing each full sequence */
+static void performTestXoofffAccumulator(void)
+{
+    Xoofff xoofff;
+    const BitString K = BitString::ones(200), prefix = BitString::zeroes(5000);
+    FarfalleAccumulator common = FarfalleAccumulator(xoofff, K).append(prefix);
+
+    for (unsigned int i = 0; i < 20; i++)
+    {
+        BitString suffix = BitString::ones(37 * i);
+        FarfalleAccumulator A = common.fork();
+        A.append(suffix);
+        assert(A.expand(700, 3 * i) == xoofff(K, suffix * BitStrings(prefix), 700, 3 * i));
+        A.append(suffix);
+        assert(A.expand(700) == xoofff(K, suffix * (suffix * BitStrings(prefix)), 700));
+    }
+    assert(common.expand(256) == xoofff(K, BitStrings(prefix), 256));
+    assert(FarfalleKeyed(xoofff, K).accumulator().append(prefix).expand(256) == common.expand(256));
+}
+
+/* Expansion into a buffer, split across threads, matches the sequential one */
+static void performTestXoofffParallel(void)
+{
+    Xoofff xoofff;
+    ThreadPool pool(3);
+    FarfalleState S = xoofff.start(BitString::ones(200));
+    const UINT64 lengths[] = { 1, 1024 * XnP_width, 5 * 1024 * XnP_width + 13 };
+    const UINT64 offsets[] = { 0, 8, 1024 * XnP_width - 8, 3000 * XnP_width + 16 };
+    bool thrown = false;
+
+    xoofff.compress(S, BitString::zeroes(1000));
+    for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+        for (unsigned int j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++)
+        {
+            BitString Z = xoofff.expand(S, lengths[i], offsets[j]);
+            std::vector<UINT8> parallel((lengths[i] + 7) / 8, 0xFF), sequential((lengths[i] + 7) / 8, 0xFF);
+            xoofff.expandTo(S, parallel.data(), lengths[i], offsets[j], &pool);
+            xoofff.expandTo(S, sequential.data(), lengths[i], offsets[j]);
+            assert(BitString(parallel.data(), lengths[i]) == Z && parallel == sequential);
+        }
+
+    const UINT64 sizes[] = { 0, 1024 * XnP_width - 1, 1024 * XnP_width, 3 * 1024 * XnP_width, 2500 * XnP_width + 77 };
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        FarfalleState T = S, U = S;
+        BitString M = BitString::ones(sizes[i]);
+        xoofff.compress(T, M, &pool);
+        xoofff.compress(U, M);
+        assert(T.x == U.x && T.kI == U.kI && T.I == U.I);
+        assert(xoofff(BitString::ones(200), BitStrings(M) * M, 512, 0, &pool) == xoofff(BitString::ones(200), BitStrings(M) * M, 512));
+    }
+
+    try {
+        pool.run(std::vector<std::function<void()> >(10, [] { throw Exception("task"); }));
+    }
+    catch (Exception &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+/*
+ * Keyed evaluation, directly or through a small cache that evicts keys, matches the one-shot function,
+ * and so do WBC and WBC-AE objects sharing one cache of key setups
+ */
+static void performTestXoofffKeyed(void)
+{
+    Xoofff xoofff;
+    FarfalleKeyCache cache(xoofff, 2);
+    XoofffWBCKeys keys(2);
+    XoofffWBC wbc, shared(&keys);
+    XoofffWBCAE wbcae, sharedAE(&keys);
+    BitString M = BitString::ones(1000) || 0;
+    const unsigned int order[] = { 0, 1, 0, 2, 1, 1, 0, 2, 2 };
+
+    for (unsigned int i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        BitString K = BitString::zeroes(64 + 8 * order[i]) || 1;
+        BitString Z = xoofff(K, M, 500, 3);
+        assert(FarfalleKeyed(xoofff, K)(M, 500, 3) == Z);
+        assert(cache(K)(M, 500, 3) == Z);
+
+        XoofffWBC copy(shared);
+        BitString C = wbc.encipher(K, M, Z);
+        assert(shared.encipher(K, M, Z) == C && copy.decipher(K, M, C) == Z);
+        BitString W = wbcae.wrap(K, M, Z);
+        assert(sharedAE.wrap(K, M, Z) == W && sharedAE.unwrap(K, M, W) == Z);
+    }
+}
+
 void testXoofff(void)
 {
+    performTestXoofffLengths();
+    performTestXoofffLarge();
+    performTestXoofffSeek();
+    performTestXoofffRolling();
+    performTestXoofffAccumulator();
+    performTestXoofffParallel();
+    performTestXoofffKeyed();
 
 #ifndef KeccakP1600_excluded
 #ifdef OUTPUT
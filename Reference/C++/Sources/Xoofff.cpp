@@ -12,47 +12,47 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Xoofff.h"
 
 /* XoodooCompressionRollingFunction */
-BitString XoodooCompressionRollingFunction::operator()(const BitString &k, unsigned int i) const
+void XoodooCompressionRollingFunction::step(BitString &k) const
 {
-	BitString kp = k;
-	XoodooState A(kp.array());
-
-	for (unsigned int j = 0; j < i; j++)
-	{
-		A[0][0] = A[0][0] ^ shiftLane(A[0][0], 13) ^ cyclicShiftLane(A[1][0], 3);
-		XoodooPlane B = cyclicShiftPlane(A[0], 3, 0);
+	XoodooState A(k.array());
 
-		A[0] = A[1];
-		A[1] = A[2];
-		A[2] = B;
-	}
+	A[0][0] = A[0][0] ^ shiftLane(A[0][0], 13) ^ cyclicShiftLane(A[1][0], 3);
+	XoodooPlane B = cyclicShiftPlane(A[0], 3, 0);
 
-	A.write(kp.array());
+	A[0] = A[1];
+	A[1] = A[2];
+	A[2] = B;
 
-	return kp;
+	A.write(k.array());
 }
 
 /* XoodooExpansionRollingFunction */
-BitString XoodooExpansionRollingFunction::operator()(const BitString &k, unsigned int i) const
+BitString XoodooExpansionRollingFunction::operator()(const BitString &k, UINT64 i) const
 {
 	BitString kp = k;
-	XoodooState A(kp.array());
 
-	for (unsigned int j = 0; j < i; j++)
+	for (UINT64 j = 0; j < i; j++)
 	{
-		A[0][0] = (A[1][0] & A[2][0]) ^ cyclicShiftLane(A[0][0], 5) ^ cyclicShiftLane(A[1][0], 13) ^ 7;
-		XoodooPlane B = cyclicShiftPlane(A[0], 3, 0);
-
-		A[0] = A[1];
-		A[1] = A[2];
-		A[2] = B;
+		step(kp);
 	}
 
-	A.write(kp.array());
-
 	return kp;
 }
 
+void XoodooExpansionRollingFunction::step(BitString &k) const
+{
+	XoodooState A(k.array());
+
+	A[0][0] = (A[1][0] & A[2][0]) ^ cyclicShiftLane(A[0][0], 5) ^ cyclicShiftLane(A[1][0], 13) ^ 7;
+	XoodooPlane B = cyclicShiftPlane(A[0], 3, 0);
+
+	A[0] = A[1];
+	A[1] = A[2];
+	A[2] = B;
+
+	A.write(k.array());
+}
+
 /* Xoofff instantiation parameters */
 namespace XooParams
 {
@@ -104,14 +104,20 @@ XoofffSANSE::XoofffSANSE(const BitString &K)
 {
 }
 
+/* Xoofff-WBC key setups, for H = Short-Xoofff and G = Xoofff */
+XoofffWBCKeys::XoofffWBCKeys(size_t capacity)
+	: FarfalleWBCKeys(make_Short_Xoofff(), make_Xoofff(), capacity)
+{
+}
+
 /* Xoofff-WBC */
-XoofffWBC::XoofffWBC()
-	: FarfalleWBC(make_Short_Xoofff(), make_Xoofff(), XooParams::param_WBC_l)
+XoofffWBC::XoofffWBC(XoofffWBCKeys *keys)
+	: FarfalleWBC(make_Short_Xoofff(), make_Xoofff(), XooParams::param_WBC_l, keys)
 {
 }
 
 /* Xoofff-WBC-AE */
-XoofffWBCAE::XoofffWBCAE()
-	: FarfalleWBCAE(make_Short_Xoofff(), make_Xoofff(), XooParams::param_WBC_AE_t, XooParams::param_WBC_AE_l)
+XoofffWBCAE::XoofffWBCAE(XoofffWBCKeys *keys)
+	: FarfalleWBCAE(make_Short_Xoofff(), make_Xoofff(), XooParams::param_WBC_AE_t, XooParams::param_WBC_AE_l, keys)
 {
 }
@@ -21,16 +21,18 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "types.h"
 #include "Xoodoo.h"
 
-class XoodooCompressionRollingFunction : public BaseRollingFunction
+class XoodooCompressionRollingFunction : public LinearRollingFunction
 {
 	public:
-		BitString operator()(const BitString &k, unsigned int i) const;
+		XoodooCompressionRollingFunction() : LinearRollingFunction(384) {}
+		void step(BitString &k) const;
 };
 
 class XoodooExpansionRollingFunction : public BaseRollingFunction
 {
 	public:
-		BitString operator()(const BitString &k, unsigned int i) const;
+		BitString operator()(const BitString &k, UINT64 i) const;
+		void step(BitString &k) const;
 };
 
 class Xoofff : public Farfalle
@@ -51,16 +53,22 @@ class XoofffSANSE : public FarfalleSANSE
 		XoofffSANSE(const BitString &K);
 };
 
+class XoofffWBCKeys : public FarfalleWBCKeys
+{
+	public:
+		XoofffWBCKeys(size_t capacity = FarfalleKeyCache::DefaultCapacity);
+};
+
 class XoofffWBC : public FarfalleWBC
 {
 	public:
-		XoofffWBC();
+		XoofffWBC(XoofffWBCKeys *keys = NULL);
 };
 
 class XoofffWBCAE : public FarfalleWBCAE
 {
 	public:
-		XoofffWBCAE();
+		XoofffWBCAE(XoofffWBCKeys *keys = NULL);
 };
 
 #endif
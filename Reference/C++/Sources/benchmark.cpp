@@ -0,0 +1,407 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+/*
+ * Benchmark driver, built by "make bench" as bin/XoodooBench.
+ *
+ * Every (primitive, operation, length) case is run repeatedly and one CSV line
+ * is written with the distribution of the per-call cost: cycles from the time
+ * stamp counter (where available) and wall-clock time from std::chrono.
+ *
+ * Usage: XoodooBench [--max-length N] [--runs N] [--budget s] [--limit s]
+ *                    [--backend name] [--filter text] [--output file]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+#include "types.h"
+#include "Xoodoo.h"
+#include "Xoodoo-dispatch.h"
+#include "Xoodootimes.h"
+#include "Xoodyak.h"
+#include "Xoofff.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define XOODOO_BENCH_RDTSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define XOODOO_BENCH_RDTSC
+#endif
+
+static UINT64 cycles()
+{
+#ifdef XOODOO_BENCH_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+struct BenchOptions
+{
+	UINT64       maxLength = 64 << 20;                           // bytes
+	unsigned int runs = 21;                                      // timed runs per case, at most
+	double       budget = 1.0;                                   // seconds per case, after the first run
+	double       limit = 60.0;                                   // seconds; a case stops before a length expected to run longer
+	std::string  filter;
+	std::string  backend;
+};
+
+static volatile UINT8 sink;
+
+static void consume(const BitString &S)
+{
+	if (S.size() != 0) sink ^= S.array()[0];
+}
+
+static std::vector<UINT64> lengths(UINT64 maxLength)
+{
+	std::vector<UINT64> L{ 0, 1, 16 };
+	for (UINT64 l = 64; l <= maxLength; l *= 4) L.push_back(l);
+	while (!L.empty() && L.back() > maxLength) L.pop_back();
+	return L;
+}
+
+static BitString message(UINT64 length, UINT8 seed)
+{
+	std::vector<UINT8> m(static_cast<size_t>(length));
+	for (size_t i = 0; i < m.size(); i++) m[i] = static_cast<UINT8>(seed + 251 * i + (i >> 8));
+	return BitString(m);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double percentile(const std::vector<double> &s, double q)
+{
+	size_t i = static_cast<size_t>(std::floor(q * (s.size() - 1) + 0.5));
+	return s[std::min(i, s.size() - 1)];
+}
+
+/**
+ * One (primitive, operation) case, swept over increasing lengths
+ */
+struct Sweep
+{
+	const char *primitive;
+	const char *operation;
+	bool       active;
+	double     last;                                                 // seconds per call at the previous length
+
+	Sweep(const char *primitive, const char *operation, bool active)
+		: primitive(primitive), operation(operation), active(active), last(0) {}
+};
+
+class Bench
+{
+	private:
+		const BenchOptions &opt;
+		std::ostream       &csv;
+		std::string        backend;
+
+	public:
+		Bench(const BenchOptions &opt, std::ostream &csv)
+			: opt(opt), csv(csv), backend(getXoodooBackendName(getXoodooBackend()))
+		{
+			csv << "primitive,operation,backend,length,runs,"
+			       "cycles_min,cycles_p10,cycles_median,cycles_p90,cycles_per_byte,"
+			       "ns_median,ns_p90,mib_per_s\n";
+		}
+
+		bool selected(const char *primitive) const
+		{
+			return opt.filter.empty() || std::string(primitive).find(opt.filter) != std::string::npos;
+		}
+
+		/**
+		 * Times body() at one length of a sweep; prepare() runs before each call, untimed.
+		 * A call processes @p length bytes and is repeated @p inner times per run.
+		 * The sweep is deactivated when the next length (four times this one) is
+		 * expected to run longer than the limit, extrapolating from the growth
+		 * observed since the previous length.
+		 */
+		void run(Sweep &sweep, UINT64 length, unsigned int inner,
+		         const std::function<void()> &prepare, const std::function<void()> &body)
+		{
+			typedef std::chrono::steady_clock clock;
+			std::vector<double> c, t;
+			double spent = 0;
+
+			try
+			{
+				for (unsigned int k = 0; k <= opt.runs; k++)
+				{
+					prepare();
+					clock::time_point t0 = clock::now();
+					UINT64 c0 = cycles();
+					for (unsigned int j = 0; j < inner; j++) body();
+					UINT64 c1 = cycles();
+					double s = std::chrono::duration<double>(clock::now() - t0).count();
+
+					/* The first run is a warm-up, unless it is long enough to stand on its own */
+					if (k > 0 || s * opt.runs > opt.budget)
+					{
+						c.push_back(double(c1 - c0) / inner);
+						t.push_back(s * 1e9 / inner);
+						spent += s;
+					}
+					if (4 * s > opt.limit || (spent > opt.budget && !c.empty())) break;
+				}
+			}
+			catch (Exception e)
+			{
+				std::cerr << sweep.primitive << ' ' << sweep.operation << ' ' << length << ": " << e.what() << '\n';
+				return;
+			}
+
+			std::sort(c.begin(), c.end());
+			std::sort(t.begin(), t.end());
+			double median = percentile(c, 0.5);
+			double nsMedian = percentile(t, 0.5);
+
+			csv << sweep.primitive << ',' << sweep.operation << ',' << backend << ',' << length << ',' << c.size() << ',';
+#ifdef XOODOO_BENCH_RDTSC
+			csv << c.front() << ',' << percentile(c, 0.1) << ',' << median << ',' << percentile(c, 0.9) << ',';
+			if (length != 0) csv << median / length;
+#else
+			csv << ",,,,";
+#endif
+			csv << ',' << nsMedian << ',' << percentile(t, 0.9) << ',';
+			if (length != 0) csv << (length / 1048576.0) / (nsMedian * 1e-9);
+			csv << std::endl;
+
+			double seconds = nsMedian * inner * 1e-9;
+			double growth = (sweep.last > 1e-3) ? std::max(4.0, seconds / sweep.last) : 4.0;
+			sweep.last = seconds;
+			if (seconds * growth > opt.limit)
+			{
+				std::cerr << sweep.primitive << ' ' << sweep.operation << ": stopping after " << length << " bytes (--limit)\n";
+				sweep.active = false;
+			}
+		}
+
+		void run(Sweep &sweep, UINT64 length, unsigned int inner, const std::function<void()> &body)
+		{
+			run(sweep, length, inner, [] {}, body);
+		}
+};
+
+static void benchPermutations(Bench &bench)
+{
+	static const unsigned int inner = 1000;
+	UINT8 state[48] = { 0 };
+	std::vector<UINT32> lanes(12 * 16, 0);
+
+	Xoodoo f6(384, 6), f12(384, 12);
+	XoodooTimes<4> f4(384, 12);
+	XoodooTimes<8> f8(384, 12);
+	XoodooTimes<16> f16(384, 12);
+	Sweep p6("xoodoo[6]", "permute", bench.selected("xoodoo[6]"));
+	Sweep p12("xoodoo[12]", "permute", bench.selected("xoodoo[12]"));
+	Sweep p4x("xoodootimes4[12]", "permute", bench.selected("xoodootimes4[12]"));
+	Sweep p8x("xoodootimes8[12]", "permute", bench.selected("xoodootimes8[12]"));
+	Sweep p16x("xoodootimes16[12]", "permute", bench.selected("xoodootimes16[12]"));
+
+	if (p6.active) bench.run(p6, 48, inner, [&] { f6(state); });
+	if (p12.active) bench.run(p12, 48, inner, [&] { f12(state); });
+	if (p4x.active) bench.run(p4x, 4 * 48, inner, [&] { f4.permuteAll(lanes.data()); });
+	if (p8x.active) bench.run(p8x, 8 * 48, inner, [&] { f8.permuteAll(lanes.data()); });
+	if (p16x.active) bench.run(p16x, 16 * 48, inner, [&] { f16.permuteAll(lanes.data()); });
+}
+
+/* The batch cases copy their message 64 times: they stop at this length, beyond the short messages they are for */
+static const UINT64 BatchMaxLength = 64 << 10;
+
+static void benchXoodyak(Bench &bench, const std::vector<UINT64> &L)
+{
+	const BitString K = message(16, 1);
+	const BitString N = message(16, 2);
+	const BitString empty;
+	std::unique_ptr<Xoodyak> x;
+	Sweep hash("xoodyak-hash", "hash", bench.selected("xoodyak-hash"));
+	Sweep batch("xoodyak-hash", "hash-batch64", bench.selected("xoodyak-hash"));   // Length of the 64 messages together
+	Sweep enc("xoodyak-aead", "encrypt", bench.selected("xoodyak-aead"));
+	Sweep dec("xoodyak-aead", "decrypt", bench.selected("xoodyak-aead"));
+	Sweep encbatch("xoodyak-aead", "encrypt-batch64", bench.selected("xoodyak-aead"));   // Idem, key setup included
+
+	for (UINT64 l : L)
+	{
+		const BitString M = message(l, 3);
+		auto keyed = [&] { x.reset(new Xoodyak(K, empty, empty)); x->Absorb(N); };
+
+		if (hash.active)
+			bench.run(hash, l, 1, [&] {
+				Xoodyak h(empty, empty, empty);
+				h.Absorb(M);
+				consume(h.Squeeze(256));
+			});
+		if (batch.active && l <= BatchMaxLength)
+		{
+			const std::vector<BitString> B(64, M);
+			bench.run(batch, 64 * l, 1, [&] {
+				std::vector<BitString> H = XoodyakHashBatch()(B, 256);
+				consume(H[0]);
+			});
+		}
+		if (enc.active)
+			bench.run(enc, l, 1, keyed, [&] {
+				consume(x->Encrypt(M));
+				consume(x->Squeeze(128));
+			});
+		if (dec.active)
+		{
+			keyed();
+			const BitString C = x->Encrypt(M);
+			bench.run(dec, l, 1, keyed, [&] {
+				consume(x->Decrypt(C));
+				consume(x->Squeeze(128));
+			});
+		}
+		if (encbatch.active && l <= BatchMaxLength)
+		{
+			XoodyakPacket p;
+			p.K = K;
+			p.AD = N;
+			p.P = M;
+			const std::vector<XoodyakPacket> B(64, p);
+			bench.run(encbatch, 64 * l, 1, [&] {
+				std::vector<std::pair<BitString, BitString> > CT = XoodyakAEADBatch().encrypt(B, 128);
+				consume(CT[0].first);
+				consume(CT[0].second);
+			});
+		}
+	}
+}
+
+static void benchXoofff(Bench &bench, const std::vector<UINT64> &L)
+{
+	const BitString K = message(32, 4);
+	const BitString N = message(16, 5);
+	const BitString empty;
+	Xoofff F;
+	XoofffWBCKeys keys;                                              // The cases run under one key: its setup is cached
+	XoofffWBC wbc(&keys);
+	XoofffWBCAE wbcae(&keys);
+	ThreadPool pool;
+	FarfalleState S = F.start(K);
+	std::unique_ptr<XoofffSANE> sane;
+	std::unique_ptr<XoofffSANSE> sanse;
+	Sweep compress("xoofff", "compress", bench.selected("xoofff"));
+	Sweep compressmt("xoofff", "compress-mt", bench.selected("xoofff"));
+	Sweep expand("xoofff", "expand", bench.selected("xoofff"));
+	Sweep expandmt("xoofff", "expand-mt", bench.selected("xoofff"));
+	Sweep sanewrap("xoofff-sane", "wrap", bench.selected("xoofff-sane"));
+	Sweep sansewrap("xoofff-sanse", "wrap", bench.selected("xoofff-sanse"));
+	Sweep encipher("xoofff-wbc", "encipher", bench.selected("xoofff-wbc"));
+	Sweep wrap("xoofff-wbcae", "wrap", bench.selected("xoofff-wbcae"));
+
+	for (UINT64 l : L)
+	{
+		const BitString M = message(l, 6);
+
+		if (compress.active)
+			bench.run(compress, l, 1, [&] { consume(F(K, BitStrings(M), 256)); });
+		if (compressmt.active)
+			bench.run(compressmt, l, 1, [&] { consume(F(K, BitStrings(M), 256, 0, &pool)); });
+		if (expand.active)
+			bench.run(expand, l, 1, [&] { consume(F(K, BitStrings(empty), 8 * l)); });
+		if (expandmt.active)
+		{
+			std::vector<UINT8> Z(l);
+			bench.run(expandmt, l, 1, [&] { F.expandTo(S, Z.data(), 8 * l, 0, &pool); if (l != 0) sink ^= Z[0]; });
+		}
+		if (sanewrap.active)
+			bench.run(sanewrap, l, 1,
+				[&] { BitString T; sane.reset(new XoofffSANE(K, N, T, true)); },
+				[&] { std::pair<BitString, BitString> CT = sane->wrap(empty, M); consume(CT.first); consume(CT.second); });
+		if (sansewrap.active)
+			bench.run(sansewrap, l, 1,
+				[&] { sanse.reset(new XoofffSANSE(K)); },
+				[&] { std::pair<BitString, BitString> CT = sanse->wrap(empty, M); consume(CT.first); consume(CT.second); });
+		if (encipher.active)
+			bench.run(encipher, l, 1, [&] { consume(wbc.encipher(K, empty, M)); });
+		if (wrap.active)
+			bench.run(wrap, l, 1, [&] { consume(wbcae.wrap(K, empty, M)); });
+	}
+}
+
+static UINT64 parseLength(const std::string &s)
+{
+	char *end;
+	UINT64 n = std::strtoull(s.c_str(), &end, 10);
+	switch (*end)
+	{
+		case 'K': case 'k': n <<= 10; end++; break;
+		case 'M': case 'm': n <<= 20; end++; break;
+		case 'G': case 'g': n <<= 30; end++; break;
+	}
+	if (*end != 0 || end == s.c_str()) throw Exception("Invalid length: " + s);
+	return n;
+}
+
+static XoodooBackend parseBackend(const std::string &name)
+{
+	for (XoodooBackend b : { BACKEND_GENERIC, BACKEND_SSE2, BACKEND_AVX2, BACKEND_AVX512 })
+		if (name == getXoodooBackendName(b)) return b;
+	throw Exception("Unknown backend: " + name);
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		BenchOptions opt;
+		std::ofstream file;
+
+		for (int i = 1; i < argc; i++)
+		{
+			std::string a = argv[i];
+			if (i + 1 == argc) throw Exception("Missing value for " + a);
+			std::string v = argv[++i];
+			if (a == "--max-length") opt.maxLength = parseLength(v);
+			else if (a == "--runs") opt.runs = std::max(1, std::atoi(v.c_str()));
+			else if (a == "--budget") opt.budget = std::atof(v.c_str());
+			else if (a == "--limit") opt.limit = std::atof(v.c_str());
+			else if (a == "--filter") opt.filter = v;
+			else if (a == "--backend") opt.backend = v;
+			else if (a == "--output")
+			{
+				file.open(v);
+				if (!file) throw Exception("Cannot open " + v);
+			}
+			else throw Exception("Unknown option " + a);
+		}
+		if (!opt.backend.empty()) setXoodooBackend(parseBackend(opt.backend));
+
+		Bench bench(opt, file.is_open() ? static_cast<std::ostream &>(file) : std::cout);
+		std::vector<UINT64> L = lengths(opt.maxLength);
+		benchPermutations(bench);
+		benchXoodyak(bench, L);
+		benchXoofff(bench, L);
+	}
+	catch (Exception e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bitstring.h"
+#include "bitstring-test.h"
+
+static const unsigned int byteSizes[] = { 0, 1, 47, 48, 63, 64, 65, 127, 128, 129, 1000 };
+
+static std::vector<UINT8> randomBytes(unsigned int length)
+{
+    std::vector<UINT8> v(length);
+    for (unsigned int i = 0; i < length; i++) v[i] = (UINT8)rand();
+    return v;
+}
+
+/* Sizes on both sides of the inline capacity: construction, copy and independence of copies */
+static void performTestBitStringStorage(void)
+{
+    for (unsigned int n : byteSizes) {
+        std::vector<UINT8> v = randomBytes(n);
+        BitString S(v.data(), 8 * n);
+        assert(S.size() == 8 * n);
+        assert(n == 0 || memcmp(S.array(), v.data(), n) == 0);
+
+        BitString T(S);
+        assert(T == S);
+        for (unsigned int m : byteSizes) {
+            BitString U(std::vector<UINT8>(m, 0x5A));
+            U = S;
+            assert(U == S);
+        }
+        if (n != 0) {
+            T.array()[n - 1] ^= 1;
+            assert(!(T == S));
+            assert(memcmp(S.array(), v.data(), n) == 0);
+        }
+    }
+}
+
+/* Growing past the inline capacity one bit or one byte at a time, then shrinking back */
+static void performTestBitStringGrowth(void)
+{
+    std::vector<UINT8> v = randomBytes(200);
+    BitString bytes, bits;
+
+    for (unsigned int i = 0; i < v.size(); i++) {
+        bytes = bytes || BitString(8, v[i]);
+        for (unsigned int j = 0; j < 8; j++) bits = bits || ((v[i] >> j) & 1);
+    }
+    assert(bytes == BitString(v));
+    assert(bits == BitString(v));
+
+    for (unsigned int n : byteSizes) {
+        if (n <= v.size()) {
+            BitString S(v);
+            assert(S.truncate(8 * n) == BitString(v.data(), 8 * n));
+        }
+    }
+}
+
+/* Concatenation at aligned and unaligned offsets, across the inline capacity */
+static void performTestBitStringConcatenation(void)
+{
+    for (unsigned int n : byteSizes) {
+        for (unsigned int extra = 0; extra < 8; extra += 3) {
+            std::vector<UINT8> a = randomBytes(n + 1), b = randomBytes(70);
+            BitString A(a.data(), 8 * n + extra), B(b);
+            BitString AB = A || B;
+
+            assert(AB.size() == A.size() + B.size());
+            assert(BitString::substring(AB, 0, A.size()) == A);
+            assert(BitString::substring(AB, A.size(), B.size()) == B);
+            assert((AB ^ AB) == BitString::zeroes(AB.size()));
+        }
+    }
+}
+
+/* Chains longer than BitStringConcat::MaxParts, mixing bits and strings, against appending one term at a time */
+static void performTestBitStringLongChain(void)
+{
+    std::vector<UINT8> a = randomBytes(20), b = randomBytes(9);
+    BitString A(a.data(), 8 * 19 + 5), B(b.data(), 8 * 9);
+    BitString C = A || 1 || B || 0 || 0 || A || B || 1 || A || 1 || 1 || B || A;
+    BitString D = A;
+
+    D = D || 1;  D = D || B;  D = D || 0;  D = D || 0;  D = D || A;  D = D || B;
+    D = D || 1;  D = D || A;  D = D || 1;  D = D || 1;  D = D || B;  D = D || A;
+    assert(C == D);
+    assert((A || B || A).size() == 2 * A.size() + B.size());
+
+    /* A chain kept past its full-expression would refer to dead operands: only rvalues convert */
+    static_assert(!std::is_convertible<BitStringConcat &, BitString>::value, "A stored chain must not convert");
+    static_assert(!std::is_convertible<const BitStringConcat &, BitString>::value, "A stored chain must not convert");
+    static_assert(!std::is_copy_constructible<BitStringConcat>::value, "A chain must not be copied");
+    static_assert(std::is_convertible<BitStringConcat &&, BitString>::value, "A chain converts in its expression");
+}
+
+static BitString fromBits(const std::vector<unsigned int> &bits, unsigned int index, unsigned int size)
+{
+    BitString S;
+    for (unsigned int i = index; i < index + size && i < bits.size(); i++) S = S || bits[i];
+    return S;
+}
+
+/* Views at any bit offset: materialization, comparison, xor, concatenation and Blocks */
+static void performTestBitStringView(void)
+{
+    std::vector<UINT8> v = randomBytes(160);
+    std::vector<unsigned int> bits;
+    const BitString S(v.data(), 8 * 159 + 3);
+
+    for (unsigned int i = 0; i < S.size(); i++) bits.push_back((v[i / 8] >> (i % 8)) & 1);
+
+    for (unsigned int index = 0; index < 200; index += 13) {
+        for (unsigned int size = 0; size < 600; size += 71) {
+            BitStringView V = BitString::substring(S, index, size);
+            BitString expected = fromBits(bits, index, size);
+            BitStringView W = BitString::substring(S, index + 5, size);
+
+            assert(BitString(V) == expected);
+            assert(V == expected && expected == V);
+            assert((V ^ V) == BitString::zeroes(V.size()));
+            if (W.size() == V.size()) assert((V ^ W) == (expected ^ fromBits(bits, index + 5, size)));
+            assert((V || W || V) == (expected || BitString(W) || expected));
+        }
+    }
+
+    Blocks blocks(S, 48);
+    assert(blocks.bits().data() == S.array());
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        assert(blocks[i] == fromBits(bits, 48 * i, 48));
+    }
+
+    BitString T = S;
+    T.truncate(8 * 100);
+    T.overwrite(BitString::substring(T, 16, 8 * 90), 8 * 50);        // view into T itself, T grows
+    assert(T == (BitString::substring(S, 0, 8 * 50) || BitString::substring(S, 16, 8 * 90)));
+}
+
+/* Word-wide kernels: every bit of xor, a single differing bit, and overwrite from unaligned views */
+static void performTestBitStringKernels(void)
+{
+    std::vector<UINT8> a = randomBytes(300), b = randomBytes(300);
+    const BitString A(a), B(b);
+
+    for (unsigned int offset = 0; offset < 8; offset++) {
+        for (unsigned int size : { 1u, 7u, 63u, 64u, 65u, 129u, 1000u, 2000u }) {
+            BitStringView V = BitString::substring(A, offset, size), W = BitString::substring(B, 3 * offset, size);
+            BitString Z = V ^ W;
+            std::string z = Z.str();
+            assert(Z.size() == size);
+            for (unsigned int i = 0; i < size; i++) {
+                unsigned int x = ((a[(offset + i) / 8] >> ((offset + i) % 8)) ^ (b[(3 * offset + i) / 8] >> ((3 * offset + i) % 8))) & 1;
+                assert((((UINT8)z[i / 8] >> (i % 8)) & 1) == x);
+            }
+            if (size % 8) assert(((UINT8)z[size / 8] >> (size % 8)) == 0);
+
+            std::string c = BitString(V).str();
+            unsigned int flip = (size * 5) / 7;
+            c[flip / 8] ^= 1 << (flip % 8);
+            BitString C(c, 0, size);
+            assert(!(C == V) && !(V == C));
+            assert(BitString(V) == V);
+            assert(!equalsConstantTime(C, V) && equalsConstantTime(BitString(V), V) && equalsConstantTime(V, W) == (V == W));
+
+            BitString D = BitString::ones(size + 24);
+            D.overwrite(V, 8);
+            assert(BitString::substring(D, 8, size) == V);
+            assert(BitString::substring(D, 0, 8) == BitString::ones(8));
+            assert(BitString::substring(D, 8 + size, 16) == BitString::ones(16));
+            D.wipe();
+            assert(D == BitString::zeroes(size + 24));
+        }
+    }
+}
+
+/* Sizes and indexes past 2^32 bits, keeping at most two such strings in memory */
+static void performTestBitStringLarge(void)
+{
+    const UINT64 large = (UINT64)1 << 32;
+    const UINT64 size  = large + 125 * 8 + 5;
+    std::vector<UINT8> v = randomBytes(16);
+    const BitString P(v);
+
+    BitString S = BitString::zeroes(size);
+    assert(S.size() == size);
+    S.overwrite(P, large - 64);
+    assert(BitString::substring(S, large - 64, 128) == P);
+    assert(BitString::substring(S, large - 61, 100) == BitString::substring(P, 3, 100));
+    assert(BitString::substring(S, large + 64, 64) == BitString::zeroes(64));
+
+    Blocks blocks(S, 384);
+    assert(blocks.size() == size / 384 + 1);
+    assert(blocks[(large - 64) / 384].size() == 384);
+    assert(blocks[blocks.size() - 1].size() == size % 384);
+
+    {
+        BitString T = S || 1;
+        assert(T.size() == size + 1);
+        assert(BitString::substring(T, large - 64, 129) == (P || 0));
+        assert(BitString::substring(T, size - 64, 65) == (BitString::zeroes(64) || 1));
+    }
+    S.truncate(large + 3);
+    assert(S.size() == large + 3 && BitString::substring(S, large, 8) == BitString::substring(P, 64, 3));
+    assert(BitString::pad10(large + 24, large + 20).size() == 4);
+    assert(BitString::pad101(large + 24, large + 20).size() == 4);
+
+    bool rejected = false;
+    try {
+        BitString U = BitStringView(P.array(), 0, ~(UINT64)0 - 64) || P;
+    }
+    catch (Exception &) {
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+/* A BitString built on a std::string keeps it in sync, also once spilled to the heap */
+static void performTestBitStringAlias(void)
+{
+    std::vector<UINT8> v = randomBytes(100);
+    std::string s(16, 'x');
+    {
+        BitString S(s);
+        S.overwrite(BitString(v), 0);
+        assert(s.size() == v.size() && memcmp(s.data(), v.data(), v.size()) == 0);
+        S.truncate(8 * 10);
+        assert(s.size() == 10 && memcmp(s.data(), v.data(), 10) == 0);
+    }
+}
+
+/* Moves leave the source empty and keep aliased strings in sync */
+static void performTestBitStringMove(void)
+{
+    std::vector<UINT8> v = randomBytes(100);
+    BitString A(v), B(A);
+    BitString C(std::move(A));
+    assert(A.size() == 0 && C == B);
+    A = std::move(C);
+    assert(C.size() == 0 && A == B);
+
+    BitStrings H(BitString(1u));
+    H = B * std::move(H);
+    assert(H.size() == 2 && H[0] == BitString(1u) && H[1] == B);
+
+    std::string s(16, 'x');
+    {
+        BitString S(s);
+        BitString T(std::move(S));
+        T.overwrite(B, 0);
+        assert(s.size() == v.size() && memcmp(s.data(), v.data(), v.size()) == 0);
+        BitString U(s);
+        A = std::move(U);
+        A.truncate(8);
+        assert(s.size() == v.size());
+    }
+}
+
+void testBitString(void)
+{
+    performTestBitStringStorage();
+    performTestBitStringGrowth();
+    performTestBitStringConcatenation();
+    performTestBitStringLongChain();
+    performTestBitStringView();
+    performTestBitStringKernels();
+    performTestBitStringAlias();
+    performTestBitStringMove();
+    performTestBitStringLarge();
+}
@@ -9,12 +9,21 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "bitstring.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BITSTRING_SSE2
+#include <emmintrin.h>
+#endif
+
 static UINT8 enc8(unsigned int x)
 {
     if (x > 255) {
@@ -26,7 +35,7 @@ static UINT8 enc8(unsigned int x)
         return UINT8(x);
 }
 
-static void ref_assert(bool condition, const std::string &synopsis, const char *fct)
+static void ref_assert(bool condition, const char *synopsis, const char *fct)
 {
     if ( !condition ) {
         throw Exception((std::string(fct) + "(): " + synopsis).data());
@@ -41,10 +50,239 @@ static void ref_assert(bool condition, const std::string &synopsis, const char *
 #define assert(cond, msg)  ref_assert(cond, msg, __FUNCTION__)
 #endif
 
+ByteBuffer::ByteBuffer()
+    : p(local), n(0), capacity(InlineCapacity)
+{}
+
+ByteBuffer::ByteBuffer(size_t size, UINT8 byte)
+    : p(local), n(0), capacity(InlineCapacity)
+{
+    reserve(size);
+    n = size;
+    memset(p, byte, n);
+}
+
+ByteBuffer::ByteBuffer(const UINT8 *first, const UINT8 *last)
+    : p(local), n(0), capacity(InlineCapacity)
+{
+    assign(first, last);
+}
+
+ByteBuffer::ByteBuffer(const ByteBuffer &B)
+    : p(local), n(0), capacity(InlineCapacity)
+{
+    assign(B.begin(), B.end());
+}
+
+ByteBuffer::ByteBuffer(ByteBuffer &&B) noexcept
+    : p(local), n(0), capacity(InlineCapacity)
+{
+    *this = std::move(B);
+}
+
+ByteBuffer::~ByteBuffer()
+{
+    if ( p != local ) {
+        delete[] p;
+    }
+}
+
+ByteBuffer &ByteBuffer::operator=(const ByteBuffer &B)
+{
+    if ( this != &B ) {
+        assign(B.begin(), B.end());
+    }
+    return *this;
+}
+
+ByteBuffer &ByteBuffer::operator=(ByteBuffer &&B) noexcept
+{
+    if ( this == &B ) {
+        return *this;
+    }
+    if ( B.p != B.local ) {
+        if ( p != local ) {
+            delete[] p;
+        }
+        p        = B.p;
+        capacity = B.capacity;
+        B.p        = B.local;
+        B.capacity = InlineCapacity;
+    }
+    else {
+        memcpy(p, B.p, B.n);                                         // Fits, capacity >= InlineCapacity
+    }
+    n   = B.n;
+    B.n = 0;
+    return *this;
+}
+
+void ByteBuffer::reserve(size_t size)
+{
+    if ( size > capacity ) {
+        size_t  c = std::max(size, 2 * capacity);
+        UINT8  *q = new UINT8[c];
+        memcpy(q, p, n);
+        if ( p != local ) {
+            delete[] p;
+        }
+        p        = q;
+        capacity = c;
+    }
+}
+
+void ByteBuffer::assign(const UINT8 *first, const UINT8 *last)
+{
+    size_t size = last - first;
+    n = 0;                                                           // nothing to preserve on reallocation
+    reserve(size);
+    n = size;
+    if ( size ) {
+        memmove(p, first, size);
+    }
+}
+
+void ByteBuffer::resize(size_t size)
+{
+    reserve(size);
+    if ( size > n ) {
+        memset(p + n, 0, size - n);
+    }
+    n = size;
+}
+
+bool operator==(const ByteBuffer &A, const ByteBuffer &B)
+{
+    return (A.n == B.n) && (A.n == 0 || memcmp(A.p, B.p, A.n) == 0);
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_M_X64) || defined(_M_IX86)
+#define BITSTRING_LITTLE_ENDIAN
+#endif
+
+// Bulk operations work on 64-bit little-endian words: bit i of a word is bit (i%8) of byte i/8
+
+static inline UINT64 loadWord(const UINT8 *p)
+{
+#if defined(BITSTRING_LITTLE_ENDIAN)
+    UINT64 w;
+    memcpy(&w, p, 8);
+    return w;
+#else
+    UINT64 w = 0;
+    for ( unsigned int i = 0; i < 8; ++i ) {
+        w |= (UINT64)p[i] << (8 * i);
+    }
+    return w;
+#endif
+}
+
+static inline void storeWord(UINT8 *p, UINT64 w)
+{
+#if defined(BITSTRING_LITTLE_ENDIAN)
+    memcpy(p, &w, 8);
+#else
+    for ( unsigned int i = 0; i < 8; ++i ) {
+        p[i] = (UINT8)(w >> (8 * i));
+    }
+#endif
+}
+
+// Returns the 64 bits of src starting at bit position pos < 8*end, never reading src[end] or beyond.
+// Bits past src[end-1] are zero.
+static inline UINT64 peekWord(const UINT8 *src, UINT64 pos, size_t end)
+{
+    size_t        s     = (size_t)(pos / 8);
+    unsigned int  shift = pos % 8;
+
+    if ( s + 9 <= end ) {
+        UINT64 w = loadWord(src + s);
+        return shift ? (w >> shift) | ((UINT64)src[s + 8] << (64 - shift)) : w;
+    }
+
+    UINT64 w = 0;                                                    // at most 8 bytes left
+    for ( size_t i = s; i < end; ++i ) {
+        w |= (UINT64)src[i] << (8 * (i - s));
+    }
+    return w >> shift;
+}
+
+static void xorBytes(UINT8 *z, const UINT8 *a, const UINT8 *b, size_t n)
+{
+    size_t i = 0;
+#if defined(BITSTRING_SSE2)
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(z + i), _mm_xor_si128(x, y));
+    }
+#endif
+    for ( ; i + 8 <= n; i += 8 ) {
+        storeWord(z + i, loadWord(a + i) ^ loadWord(b + i));
+    }
+    for ( ; i < n; ++i ) {
+        z[i] = a[i] ^ b[i];
+    }
+}
+
+// Writes the viewed bits to dst, which is byte-aligned. Bits of dst following them in its last byte are kept.
+static void storeBits(UINT8 *dst, const BitStringView &S)
+{
+    const UINT8  *src    = S.data();
+    unsigned int  offset = S.bitOffset();
+    UINT64        bits   = S.size();
+    size_t        end    = (size_t)((offset + bits + 7) / 8);        // bytes of src covered
+    size_t        n      = (size_t)(bits / 8);                       // complete bytes
+    size_t        i      = 0;
+
+    if ( offset == 0 ) {
+        memcpy(dst, src, n);
+        i = n;
+    }
+    for ( ; i + 8 <= n; i += 8 ) {
+        storeWord(dst + i, peekWord(src, offset + 8 * (UINT64)i, end));
+    }
+    for ( ; i < n; ++i ) {
+        dst[i] = (UINT8)peekWord(src, offset + 8 * (UINT64)i, end);
+    }
+    if ( bits % 8 ) {
+        UINT8 mask = (1 << (bits % 8)) - 1;
+        UINT8 last = (UINT8)peekWord(src, offset + 8 * (UINT64)n, end);
+        dst[n] = (dst[n] & ~mask) | (last & mask);
+    }
+}
+
+// Writes the viewed bits at bit position pos of dst, where dst is still zero from pos onwards.
+// Bits following S in its last byte are ignored.
+static void appendBits(UINT8 *dst, UINT64 pos, const BitStringView &S)
+{
+    unsigned int head = (unsigned int)std::min<UINT64>((8 - pos % 8) % 8, S.size());  // bits completing the byte at pos
+
+    if ( head ) {
+        UINT64 w = peekWord(S.data(), S.bitOffset(), (S.bitOffset() + head + 7) / 8);
+        dst[pos / 8] |= (UINT8)((w & ((1u << head) - 1)) << (pos % 8));
+    }
+    storeBits(dst + (size_t)((pos + head) / 8), S.sub(head, S.size() - head));
+}
+
+// Number of bytes holding the given number of bits, which must be addressable
+static size_t byteCount(UINT64 bits)
+{
+    assert(bits / 8 < std::numeric_limits<size_t>::max(), "Bit string too large for this platform.");
+    return (size_t)(bits / 8 + (bits % 8 != 0));
+}
+
+// Sum of two sizes in bits, which must not wrap around
+static UINT64 sumOfSizes(UINT64 a, UINT64 b)
+{
+    assert(a <= std::numeric_limits<UINT64>::max() - b, "Bit string size exceeds 64 bits.");
+    return a + b;
+}
+
 void BitString::truncateLastByte(void)
 {
     if ( vSize % 8 ) {
-        v[vSize / 8] &= (1 << (vSize % 8)) - 1;                      // zeroize exceeding bits (for operator==())
+        v[(size_t)(vSize / 8)] &= (1 << (vSize % 8)) - 1;                      // zeroize exceeding bits (for operator==())
     }
 }
 
@@ -70,27 +308,27 @@ BitString::BitString(unsigned int bit)
     assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
 }
 
-BitString::BitString(unsigned int size, UINT8 byte)
-    : vSize(size), v((size + 7) / 8, byte), alias(NULL)
+BitString::BitString(UINT64 size, UINT8 byte)
+    : vSize(size), v(byteCount(size), byte), alias(NULL)
 {
     truncateLastByte();
 }
 
 BitString::BitString(std::string &s)
-    : vSize(s.size() * 8), v(), alias(&s)
+    : vSize((UINT64)s.size() * 8), v(), alias(&s)
 {
-    v.assign(s.c_str(), s.c_str() + s.size());
+    v.assign((const UINT8 *)s.c_str(), (const UINT8 *)s.c_str() + s.size());
 }
 
 BitString::BitString(const std::string &s)
-    : vSize(s.size() * 8), v(), alias(NULL)
+    : vSize((UINT64)s.size() * 8), v(), alias(NULL)
 {
-    v.assign(s.c_str(), s.c_str() + s.size());
+    v.assign((const UINT8 *)s.c_str(), (const UINT8 *)s.c_str() + s.size());
 }
 
-BitString::BitString(const std::string &s, unsigned int index, unsigned int size)
-    : vSize((index >= s.size() * 8) ? 0 : (size + index <= s.size() * 8) ? size : s.size() * 8 - index),
-    v(s.begin() + index / 8, s.begin() + index / 8 + ((vSize) + 7) / 8), // vSize must be initialized first! (better enable -Wreorder)
+BitString::BitString(const std::string &s, UINT64 index, UINT64 size)
+    : vSize((index >= (UINT64)s.size() * 8) ? 0 : std::min(size, (UINT64)s.size() * 8 - index)),
+    v((const UINT8 *)s.c_str() + index / 8, (const UINT8 *)s.c_str() + index / 8 + byteCount(vSize)), // vSize must be initialized first! (better enable -Wreorder)
     alias(NULL)
 {
     assert((index % 8) == 0, "This implementation only supports index that are multiple of 8.");
@@ -101,9 +339,16 @@ BitString::BitString(const BitString &S)
     : vSize(S.vSize), v(S.v), alias(NULL)                            // We don't copy the alias
 {}
 
-BitString::BitString(const BitString &S, unsigned int index, unsigned int size)
-    : vSize((index >= S.vSize) ? 0 : (size + index <= S.vSize) ? size : S.vSize - index),
-    v(S.v.begin() + index / 8, S.v.begin() + index / 8 + ((vSize) + 7) / 8),
+BitString::BitString(BitString &&S) noexcept
+    : vSize(S.vSize), v(std::move(S.v)), alias(S.alias)              // As if the copy had been elided
+{
+    S.vSize = 0;
+    S.alias = NULL;
+}
+
+BitString::BitString(const BitString &S, UINT64 index, UINT64 size)
+    : vSize((index >= S.vSize) ? 0 : std::min(size, S.vSize - index)),
+    v(S.v.begin() + index / 8, S.v.begin() + index / 8 + byteCount(vSize)),
     alias(NULL)
 {
     assert((index % 8) == 0, "This implementation only supports index that are multiple of 8.");
@@ -111,12 +356,26 @@ BitString::BitString(const BitString &S, unsigned int index, unsigned int size)
 }
 
 BitString::BitString(const std::vector<UINT8> &v)
-    : vSize(v.size() * 8), v(v), alias(NULL)
+    : vSize((UINT64)v.size() * 8), v(v.data(), v.data() + v.size()), alias(NULL)
 {}
 
-BitString::BitString(const UINT8 *s, unsigned int size)
-    : vSize(size), v(s, s + (size + 7) / 8), alias(NULL)
-{}
+BitString::BitString(const UINT8 *s, UINT64 size)
+    : vSize(size), v(s, s + byteCount(size)), alias(NULL)
+{
+    truncateLastByte();
+}
+
+BitString::BitString(const BitStringView &S)
+    : vSize(S.size()), v(byteCount(S.size()), 0), alias(NULL)
+{
+    appendBits(v.data(), 0, S);
+}
+
+BitString::BitString(BitStringConcat &&C)
+    : vSize(C.vSize), v(byteCount(C.vSize), 0), alias(NULL)
+{
+    C.writeTo(*this);
+}
 
 std::string BitString::str() const
 {
@@ -126,15 +385,15 @@ std::string BitString::str() const
 UINT8 *BitString::array()
 {
     assert((vSize % 8) == 0, "Can't get array if BitString length is not a multiple of 8."); // Because caller may modify the array and break the invariant
-    return &v[0];
+    return v.data();
 }
 
 const UINT8 *BitString::array() const
 {
-    return &v[0];
+    return v.data();
 }
 
-unsigned int BitString::size() const
+UINT64 BitString::size() const
 {
     return vSize;
 }
@@ -148,67 +407,70 @@ BitString BitString::keypack(const BitString &K, unsigned int size)
     return BitString(8, enc8(size / 8)) || K || BitString::pad10(size - 8, K.size());
 }
 
-BitString BitString::substring(const BitString &K, unsigned int index, unsigned int size)
+BitStringView BitString::substring(const BitStringView &K, UINT64 index, UINT64 size)
 {
-    unsigned int prependLength = (8 - index % 8) % 8;
-    BitString K2 = BitString::zeroes(prependLength) || K;
-    return BitString(K2, prependLength + index, size);
+    return K.sub(index, size);
 }
 
-BitString BitString::pad10(unsigned int r, unsigned int Mlen)
+BitString BitString::pad10(UINT64 r, UINT64 Mlen)
 {
     assert(0 < r, "r must be positive.");
     return BitString(1) || BitString::zeroes(r - 1 - (Mlen % r));
 }
 
-BitString BitString::pad101(unsigned int r, unsigned int Mlen)
+BitString BitString::pad101(UINT64 r, UINT64 Mlen)
 {
     assert(0 < r, "r must be positive.");
     return BitString(1) || BitString::zeroes((2 * r - 2 - (Mlen % r)) % r) || BitString(1);
 }
 
-BitString BitString::zeroes(unsigned int size)
+BitString BitString::zeroes(UINT64 size)
 {
     return BitString(size, (UINT8)0);
 }
 
-BitString BitString::ones(unsigned int size)
+BitString BitString::ones(UINT64 size)
 {
     return BitString(size, (UINT8)255);
 }
 
-BitString &BitString::truncate(unsigned int size)
+void BitString::wipe()
+{
+    volatile UINT8 *p = v.data();
+
+    for ( size_t i = 0; i < v.size(); ++i ) {
+        p[i] = 0;
+    }
+    syncAlias();
+}
+
+BitString &BitString::truncate(UINT64 size)
 {
     if ( size > vSize ) {
         return *this;
     }
     vSize = size;
-    v.resize((vSize + 7) / 8);
+    v.resize(byteCount(vSize));
     truncateLastByte();
     syncAlias();
     return *this;
 }
 
-BitString &BitString::overwrite(const BitString &S, unsigned int index)
+BitString &BitString::overwrite(const BitStringView &S, UINT64 index)
 {
     assert((index % 8) == 0, "This implementation only supports index that are multiple of 8.");
 
-    if ( index + S.vSize > vSize ) {
-        vSize = index + S.vSize;
-        v.resize((vSize + 7) / 8);
+    // A view into this string is copied first, as resizing may move the bytes it refers to
+    if ( S.data() >= v.begin() && S.data() < v.end() ) {
+        return overwrite(BitString(S), index);
     }
 
-    // Copy all complete bytes, i.e. (S.vSize/8) bytes, leaving (S.vSize%8)<8 bits left
-    copy(S.v.begin(), S.v.begin() + (S.vSize / 8), v.begin() + (index / 8));
-
-    // Copy the (S.vSize%8) remaining bits
-    if ( S.vSize % 8 ) {
-        UINT8  mask = (1 << (S.vSize % 8)) - 1;
-        UINT8  src  = S.v[S.vSize / 8];
-        UINT8 &dst  = v[(index / 8) + (S.vSize / 8)];
-        dst = (dst & ~mask) | (src & mask);
+    if ( sumOfSizes(index, S.size()) > vSize ) {
+        v.resize(byteCount(index + S.size()));
+        vSize = index + S.size();
     }
 
+    storeBits(v.data() + (size_t)(index / 8), S);
     syncAlias();
 
     return *this;
@@ -224,82 +486,225 @@ BitString &BitString::operator=(const BitString &A)
     return *this;
 }
 
-bool operator==(const BitString &A, const BitString &B)
+BitString &BitString::operator=(BitString &&A)
 {
-    return (A.vSize == B.vSize) && (A.v == B.v);
+    if ( A.alias ) {
+        return *this = static_cast<const BitString &>(A);
+    }
+    if ( this != &A ) {
+        vSize   = A.vSize;
+        v       = std::move(A.v);
+        A.vSize = 0;
+    }
+    syncAlias();
+    return *this;
 }
 
-BitString operator||(const BitString &A, unsigned int bit)
+std::ostream &operator<<(std::ostream &os, const BitString &S)
 {
-    assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
+    for ( const UINT8 *i = S.v.begin(); i != S.v.end();) {
+        os.width(2);
+        os.fill('0');
+        os << std::hex << ((int)UINT8(*i));
+        ++i;
+        if ( i != S.v.end()) {
+            os << " ";
+        }
+        else {
+            os << "(" << ((S.vSize - 1) % 8 + 1) << ")";
+        }
+    }
+    return os;
+}
 
-    BitString  Z(A);
-    Z.v.resize((Z.vSize + 8) / 8);
-    Z.v[Z.vSize / 8] |= bit << (Z.vSize % 8);
-    Z.vSize++;
+BitStringView::BitStringView()
+    : p(NULL), offset(0), vSize(0)
+{}
 
-    return Z;
+BitStringView::BitStringView(const BitString &S)
+    : p(S.array()), offset(0), vSize(S.size())
+{}
+
+BitStringView::BitStringView(const UINT8 *p, UINT64 offset, UINT64 size)
+    : p(p + (size_t)(offset / 8)), offset(offset % 8), vSize(size)
+{}
+
+BitStringView BitStringView::sub(UINT64 index, UINT64 size) const
+{
+    if ( index >= vSize ) {
+        return BitStringView(p, offset, 0);
+    }
+    return BitStringView(p, offset + index, std::min(size, vSize - index));
 }
 
-BitString operator||(const BitString &A, const BitString &B)
+bool operator==(const BitStringView &A, const BitStringView &B)
 {
-    // Allocate C
-    BitString  C(A.vSize + B.vSize, 0);
+    if ( A.size() != B.size() ) {
+        return false;
+    }
+    if ( A.bitOffset() != 0 || B.bitOffset() != 0 ) {
+        size_t aEnd = byteCount(A.bitOffset() + A.size());
+        size_t bEnd = byteCount(B.bitOffset() + B.size());
+        for ( UINT64 i = 0; i < A.size(); i += 64 ) {
+            UINT64 d = peekWord(A.data(), A.bitOffset() + i, aEnd) ^ peekWord(B.data(), B.bitOffset() + i, bEnd);
+            if ( A.size() - i < 64 ) {
+                d &= ((UINT64)1 << (A.size() - i)) - 1;
+            }
+            if ( d ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t        n    = (size_t)(A.size() / 8);
+    unsigned int  rest = A.size() % 8;
+    UINT8         mask = (1 << rest) - 1;
 
-    // Copy A into C
-    copy(A.v.begin(), A.v.end(), C.v.begin());
+    return (n == 0 || memcmp(A.data(), B.data(), n) == 0)
+        && (rest == 0 || ((A.data()[n] ^ B.data()[n]) & mask) == 0);
+}
 
-    // Append B to C, starting from index A.vSize -- do it fast if possible, possibly with overflow
-    if ((A.vSize % 8) == 0 ) {
-        C.overwrite(B, A.vSize);
+/* Like ==, without stopping at the first difference, so as not to reveal where secrets differ */
+bool equalsConstantTime(const BitStringView &A, const BitStringView &B)
+{
+    if ( A.size() != B.size() ) {
+        return false;
     }
-    else {
-        // There are (A.vSize%8) bits in last byte -- append with shift -- TODO: fast copy with 32-bit
-        std::vector<UINT8>::iterator  c     = C.v.begin() + (A.vSize / 8);
-        unsigned int             nbits = (A.vSize % 8);
-        UINT8                    last  = *c & ((1 << (nbits)) - 1);  // last = -----xxx
-
-        for ( std::vector<UINT8>::const_iterator b = B.v.begin(); b != B.v.end();) {
-            *(c++) = last | (*b << nbits);                           // *c   = -----xxx | xxxxx---
-            last   = *(b++) >> (8 - nbits);                          // last = -----xxx
-        }
 
-        if ( c != C.v.end()) {
-            *(c++) = last;
+    size_t aEnd = byteCount(A.bitOffset() + A.size());
+    size_t bEnd = byteCount(B.bitOffset() + B.size());
+    UINT64 d    = 0;
+
+    for ( UINT64 i = 0; i < A.size(); i += 64 ) {
+        UINT64 w = peekWord(A.data(), A.bitOffset() + i, aEnd) ^ peekWord(B.data(), B.bitOffset() + i, bEnd);
+        if ( A.size() - i < 64 ) {
+            w &= ((UINT64)1 << (A.size() - i)) - 1;
         }
+        d |= w;
     }
 
-    return C;
+    return d == 0;
 }
 
-BitString operator^(const BitString &A, const BitString &B)
+bool operator==(const BitStringView &A, BitStringConcat &&B)
 {
-    assert(A.vSize == B.vSize, "Cannot xor two BitString of different size.");
+    return A == BitString(std::move(B));
+}
 
-    BitString                Z(A.vSize, (UINT8)0);
-    std::vector<UINT8>::iterator  z = Z.v.begin();
-    for ( std::vector<UINT8>::const_iterator a = A.v.begin(), b = B.v.begin(); a != A.v.end(); ++a, ++b, ++z ) {
-        *z = *a ^ *b;
-    }
+bool operator==(BitStringConcat &&A, const BitStringView &B)
+{
+    return BitString(std::move(A)) == B;
+}
 
-    return Z;
+bool operator==(BitStringConcat &&A, BitStringConcat &&B)
+{
+    return BitString(std::move(A)) == BitString(std::move(B));
 }
 
-std::ostream &operator<<(std::ostream &os, const BitString &S)
+BitString operator^(const BitStringView &A, const BitStringView &B)
 {
-    for ( std::vector<UINT8>::const_iterator i = S.v.begin(); i != S.v.end();) {
-        os.width(2);
-        os.fill('0');
-        os << std::hex << ((int)UINT8(*i));
-        ++i;
-        if ( i != S.v.end()) {
-            os << " ";
+    assert(A.size() == B.size(), "Cannot xor two BitString of different size.");
+
+    BitString  Z(A.size(), 0);
+    UINT8     *z = Z.v.data();
+    size_t     n = Z.v.size();
+
+    if ( A.bitOffset() == 0 && B.bitOffset() == 0 ) {
+        xorBytes(z, A.data(), B.data(), n);
+    }
+    else {
+        size_t aEnd = byteCount(A.bitOffset() + A.size());
+        size_t bEnd = byteCount(B.bitOffset() + B.size());
+        size_t i    = 0;
+        for ( ; i + 8 <= n; i += 8 ) {
+            storeWord(z + i, peekWord(A.data(), A.bitOffset() + 8 * (UINT64)i, aEnd) ^ peekWord(B.data(), B.bitOffset() + 8 * (UINT64)i, bEnd));
         }
-        else {
-            os << "(" << ((S.vSize - 1) % 8 + 1) << ")";
+        for ( ; i < n; ++i ) {
+            z[i] = (UINT8)(peekWord(A.data(), A.bitOffset() + 8 * (UINT64)i, aEnd) ^ peekWord(B.data(), B.bitOffset() + 8 * (UINT64)i, bEnd));
         }
     }
-    return os;
+    Z.truncateLastByte();
+
+    return Z;
+}
+
+BitString operator^(const BitStringView &A, BitStringConcat &&B)
+{
+    return A ^ BitString(std::move(B));
+}
+
+BitString operator^(BitStringConcat &&A, const BitStringView &B)
+{
+    return BitString(std::move(A)) ^ B;
+}
+
+static const BitString &bitOperand(unsigned int bit)
+{
+    static const BitString bits[2] = { BitString(0u), BitString(1u) };
+
+    assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
+    return bits[bit];
+}
+
+BitStringConcat::BitStringConcat(const BitStringView &A, const BitStringView &B)
+    : count(0), vSize(0)
+{
+    append(A);
+    append(B);
+}
+
+void BitStringConcat::append(const BitStringView &S)
+{
+    if ( count == MaxParts ) {
+        std::unique_ptr<BitString> folded(new BitString(vSize, 0));
+        writeTo(*folded);
+        head = std::move(folded);
+        count = 0;
+    }
+    vSize = sumOfSizes(vSize, S.size());
+    parts[count++] = S;
+}
+
+void BitStringConcat::writeTo(BitString &Z) const
+{
+    UINT64 pos = 0;
+
+    if ( head ) {
+        std::copy(head->v.begin(), head->v.end(), Z.v.begin());
+        pos = head->vSize;
+    }
+    for ( unsigned int i = 0; i < count; ++i ) {
+        appendBits(Z.v.data(), pos, parts[i]);
+        pos += parts[i].size();
+    }
+}
+
+UINT64 BitStringConcat::size() const
+{
+    return vSize;
+}
+
+BitStringConcat operator||(const BitStringView &A, unsigned int bit)
+{
+    return BitStringConcat(A, bitOperand(bit));
+}
+
+BitStringConcat operator||(const BitStringView &A, const BitStringView &B)
+{
+    return BitStringConcat(A, B);
+}
+
+BitStringConcat operator||(BitStringConcat &&A, const BitStringView &B)
+{
+    A.append(B);
+    return std::move(A);
+}
+
+BitStringConcat operator||(BitStringConcat &&A, unsigned int bit)
+{
+    A.append(bitOperand(bit));
+    return std::move(A);
 }
 
 BitStrings::BitStrings()
@@ -311,6 +716,11 @@ BitStrings::BitStrings(const BitString &M)
 	list.push_back(M);
 }
 
+BitStrings::BitStrings(BitStringConcat &&M)
+{
+	list.push_back(std::move(M));
+}
+
 size_t BitStrings::size() const
 {
 	return list.size();
@@ -340,43 +750,44 @@ BitStrings operator*(const BitString &M, const BitStrings &B)
 	return tmp;
 }
 
+BitStrings operator*(BitString M, BitStrings &&B)
+{
+	B.list.push_back(std::move(M));
+	return std::move(B);
+}
+
 BitStrings operator*(const BitString &A, const BitString &B)
 {
 	return A * BitStrings(B);
 }
 
-Block::Block(BitString &S, unsigned int index, unsigned int r)
-    : B(S), alias(S), index(index), r(r)
+Block::Block(BitString &S, UINT64 index, unsigned int r)
+    : BitStringView(BitStringView(S).sub(index, r)), B(&S), index(index), r(r)
 {
     assert(0 < r,             "r must be positive.");
     assert(index <= S.size(), "index must be less than or equal to bit string size.");
 }
 
-static BitString  dummy; // Not nice but nobody will notice
-
-Block::Block(const BitString &S, unsigned int index, unsigned int r)
-    : B(dummy), alias(S), index(index), r(r)
+Block::Block(const BitStringView &S, UINT64 index, unsigned int r)
+    : BitStringView(S.sub(index, r)), B(NULL), index(index), r(r)
 {
     assert(0 < r,             "r must be positive.");
     assert(index <= S.size(), "index must be less than or equal to bit string size.");
 }
 
-Block &Block::operator=(const BitString &S)
+Block &Block::operator=(const BitStringView &S)
 {
+    assert(B != NULL,     "Block is not mutable.");
     assert(S.size() <= r, "String size must be less than or equal to block size.");
-    B.overwrite(S, index);
+    B->overwrite(S, index);
+    BitStringView::operator=(BitStringView(*B).sub(index, r));       // B may have grown or moved
 
     return *this;
 }
 
-Block::operator BitString() const
+Block &Block::operator=(const Block &S)
 {
-    return BitString(alias, index, r);
-}
-
-unsigned int Block::size() const
-{
-    return alias.size() < (r + index) ? alias.size() - index : r;
+    return *this = static_cast<const BitStringView &>(S);
 }
 
 std::ostream &operator<<(std::ostream &os, const Block &B)
@@ -385,40 +796,49 @@ std::ostream &operator<<(std::ostream &os, const Block &B)
 }
 
 Blocks::Blocks(unsigned int r)
-    : alias(B), const_alias(B), r(r)
+    : target(&B), r(r)
 {}
 
 Blocks::Blocks(BitString &S, unsigned int r)
-    : B(S), alias(S), const_alias(S), r(r)
+    : target(&S), r(r)
+{}
+
+Blocks::Blocks(const BitStringView &S, unsigned int r)
+    : target(NULL), source(S), r(r)
+{}
+
+Blocks::Blocks(const Blocks &S)
+    : B(S.B), target(S.target == &S.B ? &B : S.target), source(S.source), r(S.r)
 {}
 
-Blocks::Blocks(const BitString &S, unsigned int r)
-    : B(S), alias(B), const_alias(S), r(r)                           // B(S) done to allow using non-const operator[]
+Blocks::Blocks(Blocks &&S) noexcept
+    : B(std::move(S.B)), target(S.target == &S.B ? &B : S.target), source(S.source), r(S.r)
 {}
 
-unsigned int Blocks::size() const
+UINT64 Blocks::size() const
 {
-    return const_alias.size() > 0 ? (const_alias.size() + r - 1) / r : 1;
+    UINT64 n = bits().size();
+    return n > 0 ? (n + r - 1) / r : 1;
 }
 
-BitString Blocks::bits() const
+BitStringView Blocks::bits() const
 {
-    return const_alias;
+    return target ? BitStringView(*target) : source;
 }
 
-Block Blocks::operator[](unsigned int i)
+Block Blocks::operator[](UINT64 i)
 {
-    return Block(alias, i * r, r);
+    return target ? Block(*target, i * r, r) : Block(source, i * r, r);
 }
 
-Block Blocks::operator[](unsigned int i) const
+Block Blocks::operator[](UINT64 i) const
 {
-    return Block(const_alias, i * r, r);
+    return Block(bits(), i * r, r);
 }
 
 std::ostream &operator<<(std::ostream &os, const Blocks &B)
 {
-    for ( unsigned int i = 0; i < B.size(); ++i ) {
+    for ( UINT64 i = 0; i < B.size(); ++i ) {
         os << B[i];
     }
     return os;
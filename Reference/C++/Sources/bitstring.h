@@ -12,18 +12,65 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _BITSTRING_H_
 #define _BITSTRING_H_
 
+#include <cstddef>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "types.h"
 
+/**
+ * Class implementing a byte vector that keeps up to InlineCapacity bytes in
+ * place and only spills to the heap for larger sizes. This covers the state-
+ * and block-sized strings used by the modes without any allocation.
+ */
+class ByteBuffer {
+public:
+    static const size_t InlineCapacity = 64;
+protected:
+    UINT8 *  p;                                                      // points to local or to a heap block of capacity bytes
+    size_t   n;
+    size_t   capacity;
+    UINT8    local[InlineCapacity];
+    void     reserve(size_t size);
+public:
+    ByteBuffer();
+    ByteBuffer(size_t size, UINT8 byte);
+    ByteBuffer(const UINT8 *first, const UINT8 *last);
+    ByteBuffer(const ByteBuffer &B);
+    ByteBuffer(ByteBuffer &&B) noexcept;                             // Steals a heap block, copies inline bytes
+    ~ByteBuffer();
+    ByteBuffer &    operator=(const ByteBuffer &B);
+    ByteBuffer &    operator=(ByteBuffer &&B) noexcept;
+    void            assign(const UINT8 *first, const UINT8 *last);
+    void            resize(size_t size);
+    size_t          size() const { return n; }
+    UINT8 *         data() { return p; }
+    const UINT8 *   data() const { return p; }
+    UINT8 *         begin() { return p; }
+    const UINT8 *   begin() const { return p; }
+    UINT8 *         end() { return p + n; }
+    const UINT8 *   end() const { return p + n; }
+    UINT8 &         operator[](size_t i) { return p[i]; }
+    const UINT8 &   operator[](size_t i) const { return p[i]; }
+    friend bool     operator==(const ByteBuffer &A, const ByteBuffer &B);
+};
+
+bool                  operator==(const ByteBuffer &A, const ByteBuffer &B);
+
+class BitStringView;
+class BitStringConcat;
+
 /**
  * Class implementing a simple bit string
+ *
+ * Sizes and indexes are in bits, on 64 bits. A string must still fit in
+ * memory: sizes whose byte count exceeds size_t throw an Exception.
  */
 class BitString {
 protected:
-    unsigned int   vSize;                                            // size in bits -- invariant: v.size() == (vSize+7)/8
-    std::vector<UINT8>  v;                                                // vector storing bytes -- invariant: if (vSize%8), then (v[vSize/8] >> (vSize%8)) == 0
+    UINT64              vSize;                                            // size in bits -- invariant: v.size() == (vSize+7)/8
+    ByteBuffer          v;                                                // bytes -- invariant: if (vSize%8), then (v[vSize/8] >> (vSize%8)) == 0
     std::string *       alias;
     void  truncateLastByte(void);
     void  syncAlias(void);
@@ -31,40 +78,108 @@ public:
     BitString();
     ~BitString();
     BitString(unsigned int bit);
-    BitString(unsigned int size, UINT8 byte);
+    BitString(UINT64 size, UINT8 byte);
     BitString(std::string &s);                                            // By reference -- BitString will update given string accordingly
     BitString(const std::string &s);
-    BitString(const std::string &s, unsigned int index, unsigned int size);
+    BitString(const std::string &s, UINT64 index, UINT64 size);
     BitString(const BitString &S);
-    BitString(const BitString &S, unsigned int index, unsigned int size);
+    BitString(BitString &&S) noexcept;                                    // Takes over the alias of S, if any
+    BitString(const BitString &S, UINT64 index, UINT64 size);
     BitString(const std::vector<UINT8> &v);
-    BitString(const UINT8 *s, unsigned int size);
+    BitString(const UINT8 *s, UINT64 size);
+    BitString(const BitStringView &S);                                    // Copies the viewed bits
+    BitString(BitStringConcat &&C);                                       // Materializes A || B || ..., from the expression only
     std::string            str() const;
     UINT8 *           array();
     const UINT8 *     array() const;
-    unsigned int      size() const;
+    UINT64            size() const;
     static BitString  keypack(const BitString &K, unsigned int size);
-    static BitString  substring(const BitString &K, unsigned int index, unsigned int size);
-    static BitString  pad10(unsigned int r, unsigned int Mlen);
-    static BitString  pad101(unsigned int r, unsigned int Mlen);
-    static BitString  zeroes(unsigned int size);
-    static BitString  ones(unsigned int size);
-    BitString &       truncate(unsigned int size);
-    BitString &       overwrite(const BitString &S, unsigned int index);
+    static BitStringView  substring(const BitStringView &K, UINT64 index, UINT64 size);
+    static BitString  pad10(UINT64 r, UINT64 Mlen);
+    static BitString  pad101(UINT64 r, UINT64 Mlen);
+    static BitString  zeroes(UINT64 size);
+    static BitString  ones(UINT64 size);
+    BitString &       truncate(UINT64 size);
+    void              wipe();                                        // Zeroes the bits, not optimized away, for secrets
+    BitString &       overwrite(const BitStringView &S, UINT64 index);
     BitString &       operator=(const BitString &A);
-    friend bool       operator==(const BitString &A, const BitString &B);
-    friend BitString  operator||(const BitString &A, unsigned int bit);
-    friend BitString  operator||(const BitString &A, const BitString &B);
-    friend BitString  operator^(const BitString &A, const BitString &B);
+    BitString &       operator=(BitString &&A);                      // Copies if A has an alias, as A must keep it in sync
+    friend BitString  operator^(const BitStringView &A, const BitStringView &B);
     friend std::ostream &  operator<<(std::ostream &os, const BitString &S);
+    friend class      BitStringConcat;
 };
 
-bool                  operator==(const BitString &A, const BitString &B);
-BitString             operator||(const BitString &A, unsigned int bit);
-BitString             operator||(const BitString &A, const BitString &B);
-BitString             operator^(const BitString &A, const BitString &B);
 std::ostream &             operator<<(std::ostream &os, const BitString &S);
 
+/**
+ * Class implementing a read-only view of bits stored elsewhere
+ *
+ * A view is a byte pointer, a bit offset below 8 and a size in bits. It does
+ * not own the bits: it must not outlive the BitString (or buffer) it refers to,
+ * nor be used after that string is resized. Unlike in a BitString, the bits
+ * following the view in its last byte are not necessarily zero.
+ */
+class BitStringView {
+protected:
+    const UINT8 *    p;                                              // byte holding the first bit
+    unsigned int     offset;                                         // position of the first bit in *p, < 8
+    UINT64           vSize;
+public:
+    BitStringView();
+    BitStringView(const BitString &S);
+    BitStringView(const UINT8 *p, UINT64 offset, UINT64 size);
+    const UINT8 *    data() const { return p; }
+    unsigned int     bitOffset() const { return offset; }
+    UINT64           size() const { return vSize; }
+    BitStringView    sub(UINT64 index, UINT64 size) const;           // Clamped to the bits available
+};
+
+bool                  operator==(const BitStringView &A, const BitStringView &B);
+bool                  operator==(const BitStringView &A, BitStringConcat &&B);
+bool                  operator==(BitStringConcat &&A, const BitStringView &B);
+bool                  operator==(BitStringConcat &&A, BitStringConcat &&B);
+bool                  equalsConstantTime(const BitStringView &A, const BitStringView &B);  // Time depends on the sizes only
+BitString             operator^(const BitStringView &A, const BitStringView &B);
+BitString             operator^(const BitStringView &A, BitStringConcat &&B);
+BitString             operator^(BitStringConcat &&A, const BitStringView &B);
+
+/**
+ * Class implementing a lazy concatenation of bit strings
+ *
+ * operator|| only records its operands. The result is built once, in a buffer
+ * of the exact size, when the chain is converted to a BitString. Operands are
+ * referenced, not copied, so a chain must be converted within the full-
+ * expression that builds it, as in "BitString C = A || 0 || B;". Only an
+ * rvalue chain converts: a chain kept in a variable does not compile where a
+ * BitString is expected.
+ */
+class BitStringConcat {
+public:
+    static const unsigned int MaxParts = 8;
+protected:
+    std::unique_ptr<BitString>  head;                                // Operands folded in when parts is full, or NULL
+    BitStringView               parts[MaxParts];
+    unsigned int                count;
+    UINT64                      vSize;
+    void          append(const BitStringView &S);
+    void          writeTo(BitString &Z) const;
+public:
+    BitStringConcat(const BitStringView &A, const BitStringView &B);
+    BitStringConcat(const BitStringConcat &C) = delete;
+    BitStringConcat(BitStringConcat &&C) = default;
+    BitStringConcat &  operator=(const BitStringConcat &C) = delete;
+    BitStringConcat &  operator=(BitStringConcat &&C) = delete;
+    UINT64        size() const;
+    friend class BitString;
+    friend BitStringConcat  operator||(BitStringConcat &&A, const BitStringView &B);
+    friend BitStringConcat  operator||(BitStringConcat &&A, unsigned int bit);
+};
+
+BitStringConcat       operator||(const BitStringView &A, unsigned int bit);
+BitStringConcat       operator||(const BitStringView &A, const BitStringView &B);
+BitStringConcat       operator||(BitStringConcat &&A, const BitStringView &B);
+BitStringConcat       operator||(BitStringConcat &&A, unsigned int bit);
+
 /**
  * Class implementing a string of bit strings
  */
@@ -76,30 +191,34 @@ class BitStrings
 	public:
 		BitStrings();
 		BitStrings(const BitString &M);
+		BitStrings(BitStringConcat &&M);
 		size_t size() const;
 		const BitString &operator[](size_t i) const;
 		BitString &operator[](size_t i);
 		BitStrings operator*(const BitString &M) const;
 		friend BitStrings operator*(const BitString &M, const BitStrings &B);
+		friend BitStrings operator*(BitString M, BitStrings &&B);       // Appends to B in place
 };
 
 BitStrings operator*(const BitString &A, const BitString &B);
+BitStrings operator*(BitString M, BitStrings &&B);
 
 /**
  * Class implementing a simple block of bits
+ *
+ * A Block is a view of its bits. It is mutable if it was taken from a
+ * non-const BitString, in which case assigning to it overwrites them.
  */
-class Block {
+class Block : public BitStringView {
 protected:
-    BitString &      B;
-    const BitString &alias;                                          // Block is mutable if &B == &alias
-    unsigned int     index;
+    BitString *      B;                                              // NULL if not mutable
+    UINT64           index;
     unsigned int     r;
 public:
-    Block(BitString &S, unsigned int index, unsigned int r);
-    Block(const BitString &S, unsigned int index, unsigned int r);
-    Block &         operator=(const BitString &S);
-    operator BitString() const;
-    unsigned int    size() const;
+    Block(BitString &S, UINT64 index, unsigned int r);
+    Block(const BitStringView &S, UINT64 index, unsigned int r);
+    Block &         operator=(const BitStringView &S);
+    Block &         operator=(const Block &S);
     friend std::ostream &operator<<(std::ostream &os, const Block &B);
 };
 
@@ -111,17 +230,19 @@ std::ostream &           operator<<(std::ostream &os, const Block &B);
 class Blocks {
 protected:
     BitString        B;
-    BitString &      alias;
-    const BitString &const_alias;                                    // Block is mutable if &alias == &const_alias
+    BitString *      target;                                         // Mutable storage, or NULL if not mutable
+    BitStringView    source;                                         // Bits of a non-mutable Blocks
     unsigned int     r;
 public:
     Blocks(unsigned int r);                                          // Use internal BitString for storage
     Blocks(BitString &S, unsigned int r);                            // Use given BitString for storage
-    Blocks(const BitString &S, unsigned int r);                      // Idem, but not mutable
-    unsigned int    size() const;
-    BitString       bits() const;
-    Block           operator[](unsigned int i);
-    Block           operator[](unsigned int i) const;
+    Blocks(const BitStringView &S, unsigned int r);                  // View the given bits, not mutable
+    Blocks(const Blocks &S);
+    Blocks(Blocks &&S) noexcept;
+    UINT64          size() const;
+    BitStringView   bits() const;
+    Block           operator[](UINT64 i);
+    Block           operator[](UINT64 i) const;
     friend std::ostream &operator<<(std::ostream &os, const Blocks &B);
 };
 
@@ -12,10 +12,13 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
 #include "types.h"
+#include "bitstring-test.h"
+#include "Xoodoo-test.h"
 #include "Xoofff.h"
 #include "Xoofff-test.h"
 #include "XooModes-test.h"
@@ -28,18 +31,24 @@ void testXoodoo(int iterations, std::ostream &os)
 	std::fill(std::begin(state), std::end(state), 0);
 
 	Xoodoo wp(384, 12);
-	wp.setLog(LOG_ROUND, os);
+	UINT8 trace[12 * 48];
 
 	os << "Permutation 1 (starting with a state of all zeros)\n";
-	wp(reinterpret_cast<UINT8 *>(&state[0]));
+	wp(reinterpret_cast<UINT8 *>(&state[0]), XoodooRoundRecorder(trace));
+	for (int r = 1; r <= 12; r++)
+	{
+		std::ios::fmtflags f(os.flags());
+		os << "(Round " << std::setfill('0') << std::setw(2) << r << ") ";
+		os.flags(f);
+		XoodooState(trace + 48 * (r - 1)).dump(os);
+	}
 	os << '\n';
 
-	wp.setLog(LOG_FINAL, os);
-
 	for (int i = 2; i <= iterations; i++)
 	{
 		os << "Permutation " << i << "\n";
 		wp(reinterpret_cast<UINT8 *>(&state[0]));
+		XoodooState(reinterpret_cast<UINT8 *>(&state[0])).dump(os);
 		os << '\n';
 	}
 }
@@ -49,6 +58,8 @@ int main(int argc, char *argv[])
 	try
 	{
 		//testXoodoo(384, std::cout);
+		testBitString();
+		testXoodooImplementations();
 		testXoofff();
 		testXooModes();
 		testXoodyak();
@@ -0,0 +1,105 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <utility>
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: pending(0), stopping(false)
+{
+	for (unsigned int i = 1; i < threads; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	ready.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+unsigned int ThreadPool::size() const
+{
+	return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+unsigned int ThreadPool::defaultSize()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+/* Runs the task at the front of the queue, with the lock released meanwhile */
+void ThreadPool::runOne(std::unique_lock<std::mutex> &guard)
+{
+	std::function<void()> task = std::move(queue.front());
+	std::exception_ptr e;
+
+	queue.pop_front();
+	guard.unlock();
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+		e = std::current_exception();
+	}
+	guard.lock();
+
+	if (e && !error) error = e;
+	if (--pending == 0) idle.notify_all();
+}
+
+void ThreadPool::work()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	for (;;)
+	{
+		ready.wait(guard, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) return;
+		runOne(guard);
+	}
+}
+
+void ThreadPool::run(std::vector<std::function<void()> > tasks)
+{
+	std::lock_guard<std::mutex> serial(batch);
+	std::unique_lock<std::mutex> guard(lock);
+
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		queue.push_back(std::move(tasks[i]));
+	}
+	pending += tasks.size();
+	ready.notify_all();
+
+	while (!queue.empty())
+	{
+		runOne(guard);
+	}
+	idle.wait(guard, [this] { return pending == 0; });
+
+	std::exception_ptr e = error;
+	error = std::exception_ptr();
+	if (e) std::rethrow_exception(e);
+}
@@ -0,0 +1,55 @@
+/*
+Implementation by Seth Hoffert, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our websites:
+https://keccak.team/xoodoo.html
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Class implementing a fixed set of threads running batches of tasks
+ *
+ * run() queues a batch, takes part in running it and returns once every task
+ * is done; if tasks throw, the first exception is rethrown. A pool of size n
+ * has n - 1 worker threads, the caller of run() being the n-th.
+ */
+class ThreadPool
+{
+	protected:
+		std::vector<std::thread>            workers;
+		std::deque<std::function<void()> >  queue;
+		std::mutex                          lock;                    // Guards all members below
+		std::mutex                          batch;                   // Serializes calls to run()
+		std::condition_variable             ready;                   // Tasks were queued, or the pool is stopping
+		std::condition_variable             idle;                    // The last task of a batch is done
+		size_t                              pending;                 // Tasks of the batch not done yet
+		std::exception_ptr                  error;
+		bool                                stopping;
+
+		void work();
+		void runOne(std::unique_lock<std::mutex> &guard);
+
+	public:
+		ThreadPool(unsigned int threads = defaultSize());
+		~ThreadPool();
+		unsigned int size() const;
+		void run(std::vector<std::function<void()> > tasks);
+
+		static unsigned int defaultSize();
+};
+
+#endif
@@ -11,8 +11,10 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 #ifndef _TRANSFORMATIONS_H_
 #define _TRANSFORMATIONS_H_
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "bitstring.h"
 #include "types.h"
 
@@ -80,6 +82,18 @@ public:
     virtual void inverse(UINT8 * state) const {(void)state;}
 };
 
+/**
+  * Applies @a f to each of the @a count given states. Transformations that
+  * can process several states at once overload this function.
+  */
+template<class T>
+void transformAll(const T &f, UINT8 *const *states, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        f(states[i]);
+    }
+}
+
 /**
  * Class implementing an iterable permutation
  */
@@ -92,6 +106,27 @@ class BaseIterableTransformation
 		BaseIterableTransformation(unsigned int width, unsigned int rounds) : width(width), rounds(rounds) {}
 
 		virtual BitString operator()(const BitString &state) const = 0;
+
+		/**
+		  * Applies the transformation in place to the width / 8 bytes at @a state.
+		  */
+		virtual void apply(UINT8 *state) const
+		{
+			BitString result = (*this)(BitString(state, width));
+			std::copy(result.array(), result.array() + width / 8, state);
+		}
+
+		/**
+		  * Applies the transformation to each of the independent @a states in
+		  * place. The states must all have a size of width bits.
+		  */
+		virtual void applyAll(std::vector<BitString> &states) const
+		{
+			for (size_t i = 0; i < states.size(); i++)
+			{
+				states[i] = (*this)(states[i]);
+			}
+		}
 };
 
 template<class T>
@@ -110,6 +145,23 @@ class IterableTransformation : public BaseIterableTransformation
 			f(state2.array());
 			return state2;
 		}
+
+		void apply(UINT8 *state) const
+		{
+			f(state);
+		}
+
+		void applyAll(std::vector<BitString> &states) const
+		{
+			std::vector<UINT8 *> arrays(states.size());
+
+			for (size_t i = 0; i < states.size(); i++)
+			{
+				arrays[i] = states[i].array();
+			}
+
+			transformAll(f, arrays.data(), static_cast<unsigned int>(arrays.size()));
+		}
 };
 
 #endif